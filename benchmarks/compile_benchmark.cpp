@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shader_corpus.hpp"
+
+namespace fs = std::filesystem;
+namespace sb = ::shaders::benchmark;
+
+struct BenchmarkOptions {
+	fs::path processorPath;
+	fs::path corpusDirectory = "shader_corpus";
+	fs::path outputPath;
+	std::optional<std::uint32_t> jobs;
+	sb::CorpusOptions corpus;
+};
+
+struct RunResult {
+	std::string name;
+	double seconds = 0.0;
+	// The amount of shaders that were actually compiled, which is less than the corpus for incremental runs.
+	std::size_t compiledShaders = 0;
+	double shadersPerSecond = 0.0;
+	double p50Milliseconds = 0.0;
+	double p99Milliseconds = 0.0;
+	std::uint64_t peakMemoryBytes = 0;
+};
+
+// Asks the kernel to drop the cached pages of every corpus file, so that the cold run actually reads from disk.
+// This is only a hint, and dropping the caches of the whole system would require root.
+void evictPageCache(const fs::path& directory) {
+	for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+		if (!entry.is_regular_file()) {
+			continue;
+		}
+		auto fd = ::open(entry.path().c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd >= 0) {
+			::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
+	}
+}
+
+// Runs the processor in the output directory and measures its wall time and peak memory. Every run has its own
+// timings file, which can be seeded with the timings of a previous run. Runs without force skip the libraries that
+// did not change since the previous run.
+std::optional<RunResult> runProcessor(const BenchmarkOptions& options, const sb::Corpus& corpus, const fs::path& outputDirectory,
+                                      std::string name, bool force, const fs::path& seedTimingsPath) {
+	auto timingsPath = outputDirectory / (name + ".timings");
+	std::error_code error;
+	fs::remove(timingsPath, error);
+	if (!seedTimingsPath.empty()) {
+		fs::copy_file(seedTimingsPath, timingsPath, error);
+	}
+
+	std::vector<std::string> args = { options.processorPath.string(), "--manifest", corpus.manifest.string(), "--timings", timingsPath.string() };
+	if (force) {
+		args.emplace_back("--force");
+	}
+	if (options.jobs.has_value()) {
+		args.emplace_back("--jobs");
+		args.emplace_back(std::to_string(*options.jobs));
+	}
+	std::vector<char*> argv;
+	for (auto& arg : args) {
+		argv.emplace_back(arg.data());
+	}
+	argv.emplace_back(nullptr);
+
+	auto logPath = outputDirectory / (name + ".log");
+	auto start = std::chrono::steady_clock::now();
+	auto pid = ::fork();
+	if (pid < 0) {
+		std::cerr << "Failed to start " << options.processorPath << std::endl;
+		return std::nullopt;
+	}
+	if (pid == 0) {
+		auto log = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (log < 0 || ::chdir(outputDirectory.c_str()) != 0) {
+			::_exit(127);
+		}
+		::dup2(log, STDOUT_FILENO);
+		::dup2(log, STDERR_FILENO);
+		::execv(argv.front(), argv.data());
+		::_exit(127);
+	}
+
+	int status = 0;
+	rusage usage = {};
+	if (::wait4(pid, &status, 0, &usage) != pid) {
+		std::cerr << "Failed to wait for " << options.processorPath << std::endl;
+		return std::nullopt;
+	}
+	auto end = std::chrono::steady_clock::now();
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		std::cerr << "The " << name << " run failed, see " << logPath << std::endl;
+		return std::nullopt;
+	}
+
+	RunResult result = {
+		.name = std::move(name),
+		.seconds = std::chrono::duration<double>(end - start).count(),
+		// Linux reports the maximum resident set size in kilobytes.
+		.peakMemoryBytes = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024,
+	};
+
+	// The timings file contains the duration of every job in microseconds, including the jobs of the seed that did
+	// not run again. Only forced runs and runs without a seed therefore have exactly the latencies of their own jobs.
+	// The version line is skipped as it does not start with a number.
+	std::vector<std::uint32_t> latencies;
+	std::ifstream timings(timingsPath);
+	std::string line;
+	while (std::getline(timings, line)) {
+		std::uint32_t microseconds = 0;
+		if (std::from_chars(line.data(), line.data() + line.size(), microseconds).ec == std::errc {}) {
+			latencies.emplace_back(microseconds);
+		}
+	}
+
+	if (!latencies.empty()) {
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&latencies](double fraction) {
+			auto index = static_cast<std::size_t>(fraction * static_cast<double>(latencies.size() - 1));
+			return static_cast<double>(latencies[index]) / 1000.0;
+		};
+		result.p50Milliseconds = percentile(0.50);
+		result.p99Milliseconds = percentile(0.99);
+	}
+	result.compiledShaders = latencies.size();
+	result.shadersPerSecond = static_cast<double>(result.compiledShaders) / result.seconds;
+	return result;
+}
+
+std::string serializeResults(const BenchmarkOptions& options, const sb::Corpus& corpus, const std::vector<RunResult>& runs) {
+	std::ostringstream out;
+	out << "{\n  \"corpus\": { \"shaders\": " << corpus.shaderCount << ", \"libraries\": " << corpus.jsons.size()
+	    << ", \"includeDepth\": " << options.corpus.includeDepth << ", \"seed\": " << options.corpus.seed << " },\n  \"runs\": [";
+	for (std::size_t i = 0; i < runs.size(); ++i) {
+		const auto& run = runs[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << run.name << "\", \"seconds\": " << run.seconds
+		    << ", \"compiledShaders\": " << run.compiledShaders << ", \"shadersPerSecond\": " << run.shadersPerSecond << ", \"p50Milliseconds\": " << run.p50Milliseconds
+		    << ", \"p99Milliseconds\": " << run.p99Milliseconds << ", \"peakMemoryBytes\": " << run.peakMemoryBytes << " }";
+	}
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+template <typename T>
+bool parseNumber(std::string_view value, T& result) {
+	auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+	return error == std::errc {} && ptr == value.data() + value.size();
+}
+
+int main(int argc, char* argv[]) {
+	BenchmarkOptions options;
+	std::span<char*> args = { std::next(argv), static_cast<size_t>(argc - 1) };
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--slang") {
+			options.corpus.slang = true;
+			continue;
+		}
+
+		if (std::next(it) == args.end()) {
+			std::cerr << "Missing value after " << arg << "." << std::endl;
+			return -1;
+		}
+		std::string_view value = *(++it);
+
+		bool valid = true;
+		if (arg == "--processor") {
+			options.processorPath = fs::absolute(value);
+		} else if (arg == "--corpus") {
+			options.corpusDirectory = value;
+		} else if (arg == "--output") {
+			options.outputPath = value;
+		} else if (arg == "--jobs") {
+			options.jobs.emplace();
+			valid = parseNumber(value, *options.jobs);
+		} else if (arg == "--shaders") {
+			valid = parseNumber(value, options.corpus.shaderCount);
+		} else if (arg == "--include-depth") {
+			valid = parseNumber(value, options.corpus.includeDepth);
+		} else if (arg == "--seed") {
+			valid = parseNumber(value, options.corpus.seed);
+		} else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return -1;
+		}
+
+		if (!valid) {
+			std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+			return -1;
+		}
+	}
+
+	if (options.processorPath.empty()) {
+		std::cerr << "Usage: shader_benchmark --processor <shaderprocessor> [--corpus <dir>] [--output <json>] [--jobs <count>]"
+		             " [--shaders <count>] [--include-depth <depth>] [--seed <seed>] [--slang]"
+		          << std::endl;
+		return -1;
+	}
+
+	options.corpusDirectory = fs::absolute(options.corpusDirectory);
+	std::cout << "Generating corpus in " << options.corpusDirectory << std::endl;
+	auto corpus = sb::generateCorpus(options.corpusDirectory, options.corpus);
+	auto outputDirectory = options.corpusDirectory / "output";
+	fs::create_directories(outputDirectory);
+
+	std::vector<RunResult> runs;
+	auto run = [&](std::string name, bool force, const fs::path& seedTimingsPath) {
+		std::cout << "Running " << name << " build of " << corpus.shaderCount << " shaders" << std::endl;
+		auto result = runProcessor(options, corpus, outputDirectory, std::move(name), force, seedTimingsPath);
+		if (result.has_value()) {
+			runs.emplace_back(std::move(*result));
+		}
+		return result.has_value();
+	};
+
+	// The cold run starts without page cache or timings, and the warm run repeats it with both. Both are forced, as
+	// the processor would skip every library otherwise. The incremental run follows a change to a header that many
+	// shaders include and only compiles the libraries that include it. It starts without timings, so that its
+	// latencies and throughput only cover the shaders it actually compiled.
+	evictPageCache(options.corpusDirectory);
+	if (!run("cold", true, {}) || !run("warm", true, outputDirectory / "cold.timings")) {
+		return -1;
+	}
+	std::ofstream(corpus.sharedInclude, std::ios::app) << "// Modified for the incremental run.\n";
+	if (!run("incremental", false, {})) {
+		return -1;
+	}
+
+	auto results = serializeResults(options, corpus, runs);
+	std::cout << results;
+	if (!options.outputPath.empty()) {
+		std::ofstream(options.outputPath, std::ios::out | std::ios::trunc) << results;
+	}
+	return 0;
+}
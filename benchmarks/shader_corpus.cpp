@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "shader_corpus.hpp"
+
+namespace fs = std::filesystem;
+namespace sb = ::shaders::benchmark;
+
+namespace {
+	// SplitMix64, used instead of the standard distributions as their results differ between implementations.
+	class Random {
+		std::uint64_t state;
+
+	public:
+		explicit Random(std::uint64_t seed) : state(seed) {}
+
+		[[nodiscard]] std::uint64_t next() {
+			std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
+		}
+
+		// Returns a value in [0, 1).
+		[[nodiscard]] double nextUnit() {
+			return static_cast<double>(next() >> 11) * 0x1.0p-53;
+		}
+
+		[[nodiscard]] std::uint32_t nextBelow(std::uint32_t bound) {
+			return static_cast<std::uint32_t>(next() % bound);
+		}
+	};
+
+	// Every base shader is compiled once for each combination of these defines.
+	constexpr std::array<std::uint32_t, 2> flagValues = { 0, 1 };
+	constexpr std::array<std::uint32_t, 3> qualityValues = { 1, 2, 4 };
+	constexpr std::size_t permutationCount = flagValues.size() * qualityValues.size();
+
+	void writeFile(const fs::path& path, const std::string& contents) {
+		std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+		file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	}
+
+	// Most shaders are small, with a long tail of very large ones, which is what real projects look like.
+	[[nodiscard]] std::uint32_t getStatementCount(Random& random) {
+		auto unit = random.nextUnit();
+		return 8 + static_cast<std::uint32_t>(unit * unit * unit * 1500.0);
+	}
+
+	void writeStatements(std::ostringstream& out, Random& random, std::uint32_t count, std::string_view indent) {
+		constexpr std::array<std::string_view, 6> operations = {
+			"value = value * {a} + {b};",
+			"value = sin(value + {a}) * {b};",
+			"value = sqrt(abs(value) + {a}) - {b};",
+			"value = mix(value, {a}, fract(value * {b}));",
+			"value = max(value, {a}) * min(value, {b});",
+			"value = exp2(clamp(value, -{a}, {b}));",
+		};
+
+		for (std::uint32_t i = 0; i < count; ++i) {
+			std::string statement { operations[random.nextBelow(operations.size())] };
+			for (auto [placeholder, value] : { std::pair { std::string_view { "{a}" }, random.nextUnit() * 4.0 },
+			                                   std::pair { std::string_view { "{b}" }, random.nextUnit() * 4.0 + 0.5 } }) {
+				std::ostringstream number;
+				number.precision(4);
+				number << std::fixed << value;
+				for (auto pos = statement.find(placeholder); pos != std::string::npos; pos = statement.find(placeholder)) {
+					statement.replace(pos, placeholder.size(), number.str());
+				}
+			}
+			out << indent << statement << '\n';
+		}
+	}
+
+	// Writes the chain of headers, where every header includes the next deeper one. Includes are resolved
+	// relative to the including source, so all of them use paths relative to the sources folder.
+	void writeIncludeChain(const fs::path& sourceFolder, Random& random, std::uint32_t depth) {
+		for (std::uint32_t level = 0; level < depth; ++level) {
+			std::ostringstream out;
+			out << "#ifndef COMMON_" << level << "_GLSL\n#define COMMON_" << level << "_GLSL\n\n";
+			if (level + 1 < depth) {
+				out << "#include \"include/common_" << level + 1 << ".glsl\"\n\n";
+			}
+			out << "float common_" << level << "(float value) {\n";
+			writeStatements(out, random, 4, "\t");
+			if (level + 1 < depth) {
+				out << "\treturn common_" << level + 1 << "(value);\n";
+			} else {
+				out << "\treturn value;\n";
+			}
+			out << "}\n\n#endif\n";
+			writeFile(sourceFolder / "include" / ("common_" + std::to_string(level) + ".glsl"), out.str());
+		}
+	}
+
+	[[nodiscard]] std::string getGlslBase(Random& random, bool compute, std::uint32_t includeDepth) {
+		std::ostringstream out;
+		if (includeDepth > 0) {
+			out << "#include \"include/common_0.glsl\"\n\n";
+		}
+
+		if (compute) {
+			out << "layout(local_size_x = 64) in;\n"
+			    << "layout(set = 0, binding = 0, std430) buffer Data {\n\tfloat values[];\n} data;\n\n"
+			    << "void main() {\n"
+			    << "\tuint index = gl_GlobalInvocationID.x;\n"
+			    << "\tfloat value = data.values[index];\n";
+		} else {
+			out << "layout(set = 0, binding = 0) uniform sampler2D inputTexture;\n"
+			    << "layout(location = 0) in vec2 uv;\n"
+			    << "layout(location = 0) out vec4 color;\n\n"
+			    << "void main() {\n"
+			    << "\tfloat value = texture(inputTexture, uv).r;\n";
+		}
+
+		if (includeDepth > 0) {
+			out << "#if FLAG_A\n\tvalue = common_0(value);\n#endif\n";
+		}
+		out << "\tfor (int i = 0; i < QUALITY; ++i) {\n";
+		writeStatements(out, random, getStatementCount(random), "\t\t");
+		out << "\t}\n";
+
+		if (compute) {
+			out << "\tdata.values[index] = value;\n}\n";
+		} else {
+			out << "\tcolor = vec4(value);\n}\n";
+		}
+		return out.str();
+	}
+
+	[[nodiscard]] std::string getSlangShader(Random& random, std::uint32_t flag, std::uint32_t quality) {
+		std::ostringstream out;
+		out << "#define FLAG_A " << flag << "\n#define QUALITY " << quality << "\n\n"
+		    << "RWStructuredBuffer<float> values;\n\n"
+		    << "[shader(\"compute\")]\n[numthreads(64, 1, 1)]\n"
+		    << "void main(uint3 id : SV_DispatchThreadID) {\n"
+		    << "\tfloat value = values[id.x];\n"
+		    << "\tfor (int i = 0; i < QUALITY; ++i) {\n";
+		writeStatements(out, random, getStatementCount(random), "\t\t");
+		out << "\t}\n\tvalues[id.x] = value;\n}\n";
+		return out.str();
+	}
+
+	struct CorpusShader {
+		std::string name;
+		std::string source;
+		std::string lang;
+		std::string stage;
+	};
+} // namespace
+
+sb::Corpus sb::generateCorpus(const fs::path& directory, const CorpusOptions& options) {
+	fs::remove_all(directory);
+	auto sourceFolder = directory / "sources";
+	fs::create_directories(sourceFolder / "include");
+
+	Random random(options.seed);
+	writeIncludeChain(sourceFolder, random, options.includeDepth);
+
+	std::vector<CorpusShader> shaders;
+	auto baseCount = (options.shaderCount + permutationCount - 1) / permutationCount;
+	for (std::uint32_t base = 0; base < baseCount; ++base) {
+		// Every fourth base is a Slang shader if requested, and every third GLSL shader is a fragment shader.
+		auto isSlang = options.slang && base % 4 == 3;
+		auto isCompute = base % 3 != 2;
+		auto baseName = "base_" + std::to_string(base);
+		if (!isSlang) {
+			writeFile(sourceFolder / "include" / (baseName + ".glsl"), getGlslBase(random, isCompute, options.includeDepth));
+		}
+
+		for (auto flag : flagValues) {
+			for (auto quality : qualityValues) {
+				auto name = baseName + "_" + std::to_string(flag) + "_" + std::to_string(quality);
+				if (isSlang) {
+					writeFile(sourceFolder / (name + ".slang"), getSlangShader(random, flag, quality));
+					shaders.emplace_back(CorpusShader { .name = name, .source = "sources/" + name + ".slang", .lang = "SLANG", .stage = "compute" });
+					continue;
+				}
+
+				std::ostringstream out;
+				out << "#version 460\n#extension GL_GOOGLE_include_directive : require\n\n"
+				    << "#define FLAG_A " << flag << "\n#define QUALITY " << quality << "\n\n"
+				    << "#include \"include/" << baseName << ".glsl\"\n";
+				writeFile(sourceFolder / (name + ".glsl"), out.str());
+				shaders.emplace_back(CorpusShader {
+					.name = name,
+					.source = "sources/" + name + ".glsl",
+					.lang = "GLSL",
+					.stage = isCompute ? "compute" : "fragment",
+				});
+			}
+		}
+	}
+
+	Corpus corpus;
+	corpus.shaderCount = static_cast<std::uint32_t>(shaders.size());
+	corpus.sharedInclude = options.includeDepth > 0 ? sourceFolder / "include" / ("common_" + std::to_string(options.includeDepth / 2) + ".glsl")
+	                                                : sourceFolder / "include" / "base_0.glsl";
+	for (std::size_t begin = 0; begin < shaders.size(); begin += options.shadersPerLibrary) {
+		auto name = "library_" + std::to_string(corpus.jsons.size());
+		std::ostringstream out;
+		out << "{\n  \"name\": \"" << name << "\",\n  \"shaders\": [";
+		for (auto i = begin; i < std::min<std::size_t>(begin + options.shadersPerLibrary, shaders.size()); ++i) {
+			const auto& shader = shaders[i];
+			out << (i == begin ? "\n" : ",\n") << "    { \"name\": \"" << shader.name << "\", \"source\": \"" << shader.source
+			    << "\", \"lang\": \"" << shader.lang << "\", \"target\": \"SPIRV\", \"entryPoints\": [{ \"name\": \"main\", \"stage\": \""
+			    << shader.stage << "\" }] }";
+		}
+		out << "\n  ]\n}\n";
+
+		auto path = directory / (name + ".json");
+		writeFile(path, out.str());
+		corpus.jsons.emplace_back(std::move(path));
+	}
+
+	std::ostringstream manifest;
+	manifest << "{\n  \"libraries\": [";
+	for (std::size_t i = 0; i < corpus.jsons.size(); ++i) {
+		manifest << (i == 0 ? "\n" : ",\n") << "    { \"json\": \"" << corpus.jsons[i].filename().generic_string() << "\" }";
+	}
+	manifest << "\n  ]\n}\n";
+	corpus.manifest = directory / "manifest.json";
+	writeFile(corpus.manifest, manifest.str());
+	return corpus;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace shaders::benchmark {
+	struct CorpusOptions {
+		// The amount of shader files, which is rounded up to a full permutation matrix.
+		std::uint32_t shaderCount = 2000;
+		std::uint32_t shadersPerLibrary = 64;
+		// Every shader includes a chain of this many headers.
+		std::uint32_t includeDepth = 12;
+		std::uint64_t seed = 1;
+		// Also generates Slang shaders, which requires a shaderprocessor built with Slang.
+		bool slang = false;
+	};
+
+	struct Corpus {
+		std::vector<std::filesystem::path> jsons;
+		std::filesystem::path manifest;
+		// A header included by many shaders, which is modified for the incremental run.
+		std::filesystem::path sharedInclude;
+		std::uint32_t shaderCount = 0;
+	};
+
+	// Writes the corpus into the directory, replacing anything that is already there. The same options
+	// always produce the same files on every platform.
+	[[nodiscard]] Corpus generateCorpus(const std::filesystem::path& directory, const CorpusOptions& options);
+} // namespace shaders::benchmark
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <span>
+#include <string>
 #include <vector>
 
+#include <shaders/file_io.hpp>
+#include <shaders/job_server.hpp>
 #include <shaders/shader_json.hpp>
+#include <shaders/shader_reflection.hpp>
 
 #ifdef WITH_SPIRV_CROSS
 typedef struct spvc_context_s* spvc_context;
@@ -18,28 +26,82 @@ typedef slang::IGlobalSession SlangSession;
 
 // This header includes the function declarations for all compile funcs for various compilers.
 namespace shaders {
-#ifdef WITH_SPIRV_CROSS
-	inline spvc_context spvcContext = nullptr;
+	// A self-contained compile job. It carries the preprocessed source and all options required to
+	// compile it, so that it can be executed without access to the files it was created from.
+	struct CompileJob {
+		ShaderLang lang;
+		// The path of the original source. This is only used for diagnostics and as a search path.
+		std::string sourcePath;
+		std::string source = {};
+		std::vector<ShaderEntryPoint> entryPoints;
+		// The source is parsed once and then compiled for each of these versions, sorted from lowest to highest.
+		std::vector<SPVVersion> spirvVersions;
+		// The files included by the source, for languages that are preprocessed when creating the job.
+		// This is only used locally, and is not sent to workers.
+		std::vector<std::filesystem::path> includes = {};
+	};
+
+	// The SPIR-V for each entry point and SPIR-V version of a job, with all versions of the first entry point first.
+	// This is empty if compilation failed.
+	using CompileJobResult = std::vector<std::vector<std::uint32_t>>;
+
+	// Every compiler is initialized on first use, so that runs which only copy binaries never pay for it. The getters
+	// are safe to call from any thread, and callers wait while another thread is still initializing the compiler.
+#ifdef WITH_GLSLANG_SHADERS
+	void initializeGlslang();
+	void finalizeGlslang();
 #endif
 
 #ifdef WITH_SLANG_SHADERS
-	inline SlangSession* slangSession = nullptr;
+	// The session itself is not fully threadsafe. Creating it takes hundreds of milliseconds.
+	SlangSession* getSlangSession();
+	void destroySlangSession();
 #endif
 
-	std::string readFileAsString(const std::filesystem::path& path);
-	std::vector<std::byte> readFileAsBytes(const std::filesystem::path& path);
+#ifdef WITH_SPIRV_CROSS
+	// The context is not threadsafe, so it is only used by the thread building the libraries.
+	spvc_context getSpvcContext();
+	void destroySpvcContext();
+#endif
+
+	// Initializes the compiler for the given language, so that it can be done on a background thread ahead
+	// of the first job. Languages without a compiler are ignored.
+	void initializeCompiler(ShaderLang lang);
+	// Releases every compiler that was initialized.
+	void finalizeCompilers();
 
 #ifdef WITH_SPIRV_CROSS
-	std::string generateMslFromSpv(std::span<std::byte> bytes);
-	std::string generateMslFromSpv(const ShaderJsonDesc& shaderJsonStage);
+	// Returns an empty string if the SPIR-V could not be translated.
+	std::string generateMslFromSpv(std::span<const std::byte> spirv, const ShaderEntryPoint& entryPoint);
+	ShaderReflectionData reflectSpirv(std::span<const std::byte> spirv, const ShaderEntryPoint& entryPoint);
 #endif
 
+	// Returns true if this executable can compile the given language to SPIR-V.
+	bool canCompileToSpirv(ShaderLang lang);
+	// Creates the job from the already read source of the description, which is preprocessed if the language supports it.
+	std::optional<CompileJob> createCompileJob(const ShaderJsonDesc& desc, std::string source);
+	// Creates the jobs on threadCount threads, as preprocessing reads every include from disk. If a jobserver is
+	// given, every thread beyond the first needs a token from it to run.
+	std::vector<std::optional<CompileJob>> createCompileJobs(std::span<const ShaderJsonDesc* const> descs, std::span<std::string> sources,
+	                                                         std::uint32_t threadCount, const JobServerClient* jobServer = nullptr);
+	// Compiles the job using the compiler for its language.
+	CompileJobResult executeCompileJob(const CompileJob& job);
+	// Executes the jobs on threadCount threads, starting them in the given order of job indices.
+	// The time each job took is stored in durations, which has to have the same size as jobs. The jobserver
+	// is used like for createCompileJobs.
+	std::vector<CompileJobResult> executeLocalCompileJobs(std::span<const CompileJob> jobs, std::span<const std::size_t> order,
+	                                                      std::uint32_t threadCount, std::span<std::chrono::microseconds> durations,
+	                                                      const JobServerClient* jobServer = nullptr);
+
 #ifdef WITH_GLSLANG_SHADERS
-	std::vector<std::uint32_t> compileGlsl(const ShaderJsonDesc& shaderStage);
+	// The paths of all included files are appended to includes.
+	std::optional<std::string> preprocessGlsl(const ShaderJsonDesc& shaderStage, const std::string& glsl,
+	                                          std::vector<std::filesystem::path>& includes);
+	std::vector<std::vector<std::uint32_t>> compileGlsl(const CompileJob& job);
 #endif
 
 #ifdef WITH_SLANG_SHADERS
-	std::vector<std::vector<std::uint32_t>> compileSlang(const ShaderJsonStage& shaderStage);
+	std::vector<std::vector<std::uint32_t>> compileSlang(const CompileJob& job);
 #endif
 
 #ifdef __APPLE__
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <shaders/compile.hpp>
+
+// This header declares the scheduling of compile jobs, which uses the durations of previous runs
+// to start the longest jobs first.
+namespace shaders {
+	// Identifies the job across runs, using its source path, language and entry points.
+	[[nodiscard]] std::string getCompileJobKey(const CompileJob& job);
+
+	// The compile durations of previous runs, stored as a small text file with a version line followed by one
+	// "<microseconds> <key>" per line.
+	class CompileTimings {
+		std::unordered_map<std::string, std::uint32_t> microseconds;
+
+	public:
+		// A missing or malformed file simply results in no known timings.
+		[[nodiscard]] static CompileTimings readFromFile(const std::filesystem::path& path);
+		// Entries of jobs that were not part of this run are kept, so that libraries sharing the file keep their timings.
+		void writeToFile(const std::filesystem::path& path) const;
+
+		void record(const CompileJob& job, std::chrono::microseconds duration);
+		[[nodiscard]] std::optional<std::uint32_t> find(const CompileJob& job) const;
+	};
+
+	// Returns the job indices ordered by their expected duration, longest first. Jobs without a known
+	// duration are estimated from the size of their source, which for GLSL already includes all includes.
+	[[nodiscard]] std::vector<std::size_t> getCompileJobOrder(std::span<const CompileJob> jobs, const CompileTimings& timings);
+} // namespace shaders
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+namespace shaders {
+	// A 128-bit content hash. This is MurmurHash3 (x64, 128-bit variant) with a seed of zero, so
+	// the values can be reproduced by any other implementation of it.
+	struct ContentHash {
+		std::uint64_t low;
+		std::uint64_t high;
+
+		[[nodiscard]] constexpr bool operator==(const ContentHash&) const = default;
+	};
+
+	[[nodiscard]] ContentHash hashContent(std::span<const std::byte> bytes);
+} // namespace shaders
+
+template <>
+struct std::hash<shaders::ContentHash> {
+	// Both halves are already well distributed, so either one makes a good hash on its own.
+	std::size_t operator()(const shaders::ContentHash& hash) const noexcept {
+		return static_cast<std::size_t>(hash.low);
+	}
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// This header declares the file I/O used by the shader processor, which batches reads and defers writes
+// so that the compile path does not block on the disk.
+namespace shaders {
+	// These return an empty string or vector if the file could not be read.
+	std::string readFileAsString(const std::filesystem::path& path);
+	std::vector<std::byte> readFileAsBytes(const std::filesystem::path& path);
+
+	// Reads all files at once, so that their latencies overlap instead of adding up. This uses io_uring where
+	// available and a small thread pool otherwise. A result is std::nullopt if the file could not be read.
+	[[nodiscard]] std::vector<std::optional<std::vector<std::byte>>> readFiles(std::span<const std::filesystem::path> paths);
+
+	// Writes files on background threads, so that building the next output does not wait for the disk.
+	class AsyncFileWriter {
+		std::vector<std::future<bool>> pendingWrites;
+
+	public:
+		AsyncFileWriter() = default;
+		AsyncFileWriter(const AsyncFileWriter&) = delete;
+		AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+		// Waits for all writes that were not waited for yet.
+		~AsyncFileWriter();
+
+		void write(std::filesystem::path path, std::vector<std::byte> bytes);
+		// Waits for all pending writes, and returns false if any of them failed.
+		[[nodiscard]] bool wait();
+	};
+} // namespace shaders
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <shaders/content_hash.hpp>
+
+// This header declares the manifest of all files a library was built from, which lets the shader processor skip
+// libraries whose inputs did not change without reading any of them.
+namespace shaders {
+	// A file is assumed to be unchanged as long as all of these stay the same.
+	struct FileStat {
+		std::uint64_t size;
+		std::int64_t modifiedTime;
+		// This is 0 on platforms without inodes.
+		std::uint64_t inode;
+
+		[[nodiscard]] constexpr bool operator==(const FileStat&) const = default;
+	};
+
+	struct FileRecord {
+		std::filesystem::path path;
+		FileStat stat;
+		// Outputs are only compared by their stat data, so this is zero for them.
+		ContentHash hash;
+	};
+
+	struct InputManifest {
+		// Everything from the command line that changes the outputs of the library.
+		std::string options;
+		std::vector<FileRecord> inputs;
+		// Outputs that were deleted or modified since the last run also require a rebuild.
+		std::vector<FileRecord> outputs;
+	};
+
+	[[nodiscard]] std::optional<FileStat> getFileStat(const std::filesystem::path& path);
+
+	// Records the stat data and content hash of every input. Inputs whose stat data matches the previous manifest
+	// take the hash from there instead of being read again. Returns std::nullopt if any file does not exist.
+	[[nodiscard]] std::optional<std::vector<FileRecord>> recordInputFiles(std::span<const std::filesystem::path> paths,
+	                                                                      const InputManifest* previous);
+	[[nodiscard]] std::optional<std::vector<FileRecord>> recordOutputFiles(std::span<const std::filesystem::path> paths);
+
+	[[nodiscard]] std::optional<InputManifest> readInputManifest(const std::filesystem::path& path);
+	[[nodiscard]] bool writeInputManifest(const std::filesystem::path& path, const InputManifest& manifest);
+
+	// Returns true if nothing changed since the manifest was written. Only inputs whose stat data changed are hashed,
+	// and if their contents are still the same, their new stat data is stored in the manifest and updated is set.
+	[[nodiscard]] bool isInputManifestCurrent(InputManifest& manifest, std::string_view options, bool& updated);
+} // namespace shaders
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+// This header declares the client side of the GNU make jobserver protocol, so that the compile threads of
+// the shader processor count against the job limit of the build that started it.
+namespace shaders {
+	class JobServerClient {
+		int readFd = -1;
+		int writeFd = -1;
+		// The descriptors are only closed if they were opened by this client, and not inherited from make.
+		bool ownsReadFd = false;
+		bool ownsWriteFd = false;
+
+		JobServerClient(int readFd, int writeFd, bool ownsReadFd, bool ownsWriteFd);
+
+	public:
+		JobServerClient(const JobServerClient&) = delete;
+		JobServerClient(JobServerClient&& other) noexcept;
+		JobServerClient& operator=(const JobServerClient&) = delete;
+		JobServerClient& operator=(JobServerClient&& other) noexcept;
+		~JobServerClient();
+
+		// Connects to the jobserver described in MAKEFLAGS, which is either "--jobserver-auth=fifo:<path>" or the
+		// inherited pipe "--jobserver-auth=<read fd>,<write fd>". Returns std::nullopt if there is no usable jobserver,
+		// which is always the case on platforms other than Unix.
+		[[nodiscard]] static std::optional<JobServerClient> fromEnvironment();
+
+		// Waits for a token, periodically checking whether it is still needed. Returns std::nullopt if it is not
+		// needed anymore or the jobserver failed. The process itself implicitly owns one token, so only threads
+		// beyond the first need to acquire one.
+		[[nodiscard]] std::optional<std::byte> acquire(const std::function<bool()>& stillNeeded) const;
+		// Every acquired token has to be given back, even if the job it was acquired for failed.
+		void release(std::byte token) const;
+	};
+} // namespace shaders
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <shaders/shader_binary.hpp>
+
+namespace shaders {
+	// Identifies a shader that no longer exists, which might still exist for other targets.
+	struct RemovedShaderBinary {
+		std::string shaderName;
+		std::string name;
+		ShaderLang lang;
+		SPVVersion spirvVersion;
+	};
+
+	struct ShaderLibraryChanges {
+		// True if the library was reloaded, which invalidates every ShaderBinary of the previous library,
+		// including the unchanged ones, as they view the old file contents.
+		bool reloaded = false;
+		// The shaders whose content hash changed, and shaders that were added, in the reloaded library.
+		std::vector<const ShaderBinary*> changedBinaries;
+		// The shaders that no longer exist.
+		std::vector<RemovedShaderBinary> removedBinaries;
+	};
+
+	// Owns a library and reloads it from its file on request, reporting which shaders changed so that
+	// only their pipelines need to be recreated. Shaders are matched by their shader and entry point names, their
+	// language and their SPIR-V version, as an entry point can be stored for several targets.
+	class ReloadableShaderLibrary {
+		std::filesystem::path path;
+		ShaderLibraryReadFlags flags;
+		ShaderLibrary library;
+		std::filesystem::file_time_type lastWriteTime = {};
+
+	public:
+		explicit ReloadableShaderLibrary(std::filesystem::path path, ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None);
+
+		[[nodiscard]] const ShaderLibrary& getLibrary() const;
+		[[nodiscard]] const std::filesystem::path& getPath() const;
+
+		// Reloads the library if the modification time of its file changed since the last load. This only
+		// queries the file's metadata, so it is cheap enough to call every frame.
+		[[nodiscard]] ShaderLibraryChanges poll();
+		// Reloads the library regardless of the modification time. If the file cannot be read, for example
+		// because it is still being written, the current library is kept and nothing is reported.
+		[[nodiscard]] ShaderLibraryChanges reload();
+	};
+} // namespace shaders
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <shaders/compile.hpp>
+#include <shaders/job_server.hpp>
+#include <shaders/shader_binary.hpp>
+
+// This header declares the protocol used to send compile jobs to other shaderprocessor instances.
+// Every message is a 32-bit magic, followed by the 32-bit size of the payload and the payload itself.
+// All values are written in native byte order and are not swapped, so workers need to have the same endianness as the
+// coordinator. A message from a machine of different endianness is rejected, which is detected through the magic.
+namespace shaders {
+	inline constinit const auto compileJobMagic = fourCharacterCode('!', 'S', 'J', 'B');
+	inline constinit const auto compileResultMagic = fourCharacterCode('!', 'S', 'J', 'R');
+
+	[[nodiscard]] std::vector<std::byte> serializeCompileJob(const CompileJob& job);
+	[[nodiscard]] std::optional<CompileJob> deserializeCompileJob(std::span<const std::byte> bytes);
+
+	[[nodiscard]] std::vector<std::byte> serializeCompileJobResult(const CompileJobResult& result);
+	[[nodiscard]] std::optional<CompileJobResult> deserializeCompileJobResult(std::span<const std::byte> bytes);
+
+	// These work on any file descriptor, so both sockets and pipes.
+	[[nodiscard]] bool sendMessage(int fd, std::uint32_t magic, std::span<const std::byte> payload);
+	[[nodiscard]] std::optional<std::vector<std::byte>> receiveMessage(int fd, std::uint32_t magic);
+
+	// Addresses are either "unix:<path>" for Unix domain sockets or "<host>:<port>" for TCP. Without a host, the
+	// loopback interface is used, and workers listen on all interfaces only with "*:<port>".
+	// This accepts connections forever and executes every job that is sent to it.
+	std::int32_t runCompileWorker(std::string_view address);
+
+	// Distributes the jobs over all given workers in the given order of job indices, executing one job
+	// per worker at a time. A result is std::nullopt if no worker could execute the job, for example because all of them
+	// were unreachable, in which case the job should be executed locally.
+	[[nodiscard]] std::vector<std::optional<CompileJobResult>> executeRemoteCompileJobs(std::span<const std::string> workerAddresses,
+	                                                                                    std::span<const CompileJob> jobs,
+	                                                                                    std::span<const std::size_t> order);
+
+	// Executes the jobs in a pool of processCount forked processes, which are reused for all jobs and each keep their
+	// own compilers, so that compilers which are not threadsafe still run in parallel. Jobs are sent over a socket
+	// pair with the protocol above, while the results are returned through memory shared with the process.
+	// A job whose process crashed fails instead of being retried, and the other processes continue. A result is
+	// std::nullopt if no process was left to execute the job, in which case it should be executed locally.
+	// The durations and the jobserver are used like for executeLocalCompileJobs. This has to be called while no
+	// other threads are running, as they would not exist in the forked processes.
+	[[nodiscard]] std::vector<std::optional<CompileJobResult>> executeProcessCompileJobs(std::uint32_t processCount,
+	                                                                                     std::span<const CompileJob> jobs,
+	                                                                                     std::span<const std::size_t> order,
+	                                                                                     std::span<std::chrono::microseconds> durations,
+	                                                                                     const JobServerClient* jobServer = nullptr);
+} // namespace shaders
@@ -2,12 +2,27 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <optional>
 #include <span>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+#include <shaders/content_hash.hpp>
+#include <shaders/shader_reflection.hpp>
+
 namespace shaders {
 	enum class ShaderStage : std::uint16_t;
 	enum class ShaderLang : std::uint8_t;
+	enum class SPVVersion : std::uint8_t;
+
+	// How the bytes of a shader are stored in a library. Readers always decode them back to the original bytes.
+	enum class ShaderCodec : std::uint8_t {
+		None = 0,
+		// The encoding from spirv_codec.hpp, which roughly halves the size of SPIR-V.
+		CompactSpirv = 1,
+	};
 
 	[[nodiscard]] constexpr std::uint32_t fourCharacterCode(char char1, char char2, char char3, char char4) {
 		return static_cast<std::uint32_t>(char1) | (static_cast<std::uint32_t>(char2) << 8) | (static_cast<std::uint32_t>(char3) << 16)
@@ -15,29 +30,85 @@ namespace shaders {
 	}
 
 	inline constinit const auto headerMagic = fourCharacterCode('!', 'S', 'B', 'F');
+	inline constinit const auto bundleHeaderMagic = fourCharacterCode('!', 'S', 'B', 'A');
+
+	// Bumped whenever the layout of the file changes in an incompatible way.
+	inline constexpr std::uint16_t headerVersion = 7;
+
+	// Every shader binary is aligned to this so that it can be used as uint32_t words without copying.
+	inline constexpr std::size_t shaderBinaryAlignment = alignof(std::uint64_t);
 
 	struct ShaderFileHeader {
 		std::uint32_t magic;
-		// This specifies the count of uint64_t integers directly afterward that represent
-		// the byte offset into the file excluding this header for that specific shader.
+		// This specifies the count of ShaderDescription structs directly afterward.
 		std::uint16_t shaderCount;
+		std::uint16_t version;
+		// The hash of the names, stages and order of all shaders, which changes whenever the indices
+		// of the shaders change. Generated ID headers contain this to detect mismatching libraries.
+		ContentHash layoutHash;
+		// This specifies the count of ShaderGroupDescription structs after the shader descriptions.
+		std::uint16_t groupCount;
+		std::uint16_t reserved;
+		// The size of everything up to the data of the first group, which is the header, the descriptions,
+		// the groups and all names. Readers that load groups on demand only read this much up front.
+		std::uint32_t indexByteSize;
 	};
 
 	struct alignas(std::uint64_t) ShaderDescription {
 		std::uint64_t byteOffset;           // The byte offset for the shader binary.
 		std::uint64_t byteSize;             // The size of the binary.
-		std::uint64_t nameByteOffset;       // The byte offset for the entry point name string.
-		std::uint64_t shaderNameByteOffset; // The byte offset for the shader name string.
+		std::uint64_t nameByteOffset;       // The byte offset for the null-terminated entry point name string.
+		std::uint64_t shaderNameByteOffset; // The byte offset for the null-terminated shader name string.
+		std::uint64_t reflectionByteOffset; // The byte offset for the reflection section.
+		std::uint64_t reflectionByteSize;   // The size of the reflection section. This is 0 if there's no reflection data.
+		ContentHash hash;                   // The hash of the shader binary, computed when packing.
 		ShaderStage stage;                  // 16 bits.
-		ShaderLang lang;                    // 8 bits. This should only be SPIR-V or AIR.
+		ShaderLang lang;                    // 8 bits. This should only be SPIR-V, MSL or AIR.
+		ShaderCodec codec;                  // 8 bits. The byte size is the size of the encoded bytes.
+		std::uint16_t group;                // The index of the group the binary and reflection are stored in.
+		SPVVersion spirvVersion;            // 8 bits. This is only meaningful for SPIR-V.
+	};
+
+	// The binaries and reflection sections of all shaders in a group are stored contiguously, so that
+	// a group can be loaded with a single read.
+	struct alignas(std::uint64_t) ShaderGroupDescription {
+		std::uint64_t nameByteOffset; // The byte offset for the null-terminated group name string.
+		std::uint64_t byteOffset;     // The byte offset of the first binary of the group.
+		std::uint64_t byteSize;       // The size of all binaries and reflection sections of the group.
+	};
+
+	struct ShaderBundleHeader {
+		std::uint32_t magic;
+		// This specifies the count of ShaderBundleEntry structs directly afterward.
+		std::uint16_t libraryCount;
+		std::uint16_t version;
 	};
 
+	struct alignas(std::uint64_t) ShaderBundleEntry {
+		std::uint64_t byteOffset;     // The byte offset for the embedded shader library.
+		std::uint64_t byteSize;       // The size of the embedded shader library.
+		std::uint64_t nameByteOffset; // The byte offset for the null-terminated library name string.
+	};
+
+	// All members view memory owned by the ShaderLibrary (or ShaderBundle) this binary was read from.
+	// The names are guaranteed to be null-terminated.
 	struct ShaderBinary {
 		ShaderStage stage;
 		ShaderLang lang;
-		std::string name;
-		std::string shaderName;
-		std::vector<std::byte> bytes;
+		// A shader can be stored for several targets, which all have the same names. This is only meaningful for SPIR-V.
+		SPVVersion spirvVersion;
+		// The codec the binary is stored with in the library. The bytes are always decoded already.
+		ShaderCodec codec;
+		std::string_view name;
+		std::string_view shaderName;
+		// The group the binary is stored in, which is empty if none was declared.
+		std::string_view group;
+		std::span<const std::byte> bytes;
+		// The content hash of the decoded bytes, which can be used as a key for pipeline caches.
+		ContentHash hash;
+		// The reflection data generated when building. This is empty if the shader processor was built
+		// without SPIRV-Cross.
+		ShaderReflection reflection;
 	};
 
 	struct ShaderInput {
@@ -48,25 +119,162 @@ namespace shaders {
 		std::string name;
 		ShaderStage stage;
 		ShaderLang lang;
+		SPVVersion spirvVersion = {};
+		ShaderReflectionData reflection = {};
+		// Inputs that cannot be encoded with the codec are stored as they are.
+		ShaderCodec codec = ShaderCodec::None;
+		// Inputs with the same group are stored next to each other, see ShaderLibraryReader.
+		std::string group;
+	};
+
+	struct ShaderBundleInput {
+		// The name the library will be looked up with, usually the "name" field of its JSON.
+		std::string name;
+		// A complete library as returned by buildShaderLibrary.
+		std::vector<std::byte> libraryBytes;
 	};
 
+	enum class ShaderLibraryReadFlags : std::uint8_t {
+		None = 0,
+		// Recomputes the content hash of every binary and fails to load if any of them mismatch.
+		VerifyHashes = 1 << 0,
+	};
+
+	constexpr ShaderLibraryReadFlags operator|(ShaderLibraryReadFlags lhs, ShaderLibraryReadFlags rhs) {
+		using EnumType = std::underlying_type_t<ShaderLibraryReadFlags>;
+		return static_cast<ShaderLibraryReadFlags>(static_cast<EnumType>(lhs) | static_cast<EnumType>(rhs));
+	}
+
+	constexpr ShaderLibraryReadFlags operator&(ShaderLibraryReadFlags lhs, ShaderLibraryReadFlags rhs) {
+		using EnumType = std::underlying_type_t<ShaderLibraryReadFlags>;
+		return static_cast<ShaderLibraryReadFlags>(static_cast<EnumType>(lhs) & static_cast<EnumType>(rhs));
+	}
+
 	class ShaderLibrary;
+	class ShaderBundle;
+	class ShaderLibraryReader;
 
-	[[nodiscard]] std::vector<std::byte> buildShaderLibrary(std::vector<ShaderInput>&& inputs);
-	[[nodiscard]] ShaderLibrary readShaderLibraryFromFile(const std::filesystem::path& path);
+	// The placement is a permutation of the input indices, which decides the order the data of the groups
+	// and of the shaders within each group is stored in. By default, this is the order of the inputs.
+	// The indices in the generated ID header always follow the order of the inputs.
+	[[nodiscard]] std::vector<std::byte> buildShaderLibrary(std::vector<ShaderInput>&& inputs, std::span<const std::size_t> placement = {});
+	[[nodiscard]] ShaderLibrary readShaderLibraryFromFile(const std::filesystem::path& path,
+	                                                      ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None);
+	// The returned library views the given memory without copying it, so the memory has to outlive the library.
+	// Only binaries stored with a codec are decoded into memory owned by the library.
+	// It also needs to be aligned to shaderBinaryAlignment, which the generated embedded headers take care of.
+	[[nodiscard]] ShaderLibrary readShaderLibraryFromMemory(std::span<const std::byte> bytes,
+	                                                        ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None);
+
+	[[nodiscard]] std::vector<std::byte> buildShaderBundle(std::vector<ShaderBundleInput>&& inputs);
+	[[nodiscard]] ShaderBundle readShaderBundleFromFile(const std::filesystem::path& path,
+	                                                    ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None);
+	// Only reads the index of the library. The returned reader has no shaders if the file could not be opened.
+	[[nodiscard]] ShaderLibraryReader openShaderLibrary(const std::filesystem::path& path,
+	                                                    ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None);
 
 	class ShaderLibrary {
-		friend ShaderLibrary readShaderLibraryFromFile(const std::filesystem::path& path);
+		friend ShaderLibrary readShaderLibraryFromFile(const std::filesystem::path& path, ShaderLibraryReadFlags flags);
+		friend ShaderLibrary readShaderLibraryFromMemory(std::span<const std::byte> bytes, ShaderLibraryReadFlags flags);
+		friend ShaderBundle readShaderBundleFromFile(const std::filesystem::path& path, ShaderLibraryReadFlags flags);
+		friend ShaderLibraryReader openShaderLibrary(const std::filesystem::path& path, ShaderLibraryReadFlags flags);
+		friend class ShaderLibraryReader;
 
 		std::string name;
+		ContentHash layoutHash = {};
+		// The raw file contents. This is empty if the library views memory owned by someone else.
+		std::vector<std::byte> storage;
+		// The decoded bytes of all binaries that are stored with a codec.
+		std::vector<std::uint32_t> decodedStorage;
 		std::vector<std::string_view> shaderNames;
+		std::vector<std::string_view> groupNames;
 		std::vector<ShaderBinary> binaries;
 
+		// Reads everything but the binaries and reflection sections from the index at the start of the bytes.
+		[[nodiscard]] static bool parseIndex(std::span<const std::byte> bytes, ShaderLibrary& library,
+		                                     std::vector<ShaderDescription>& descriptions, std::vector<ShaderGroupDescription>& groups);
+		[[nodiscard]] static bool parse(std::span<const std::byte> bytes, ShaderLibrary& library, ShaderLibraryReadFlags flags);
+
 	public:
+		ShaderLibrary() = default;
+		// The binaries view into the storage, which is why copying is not allowed.
+		ShaderLibrary(const ShaderLibrary&) = delete;
+		ShaderLibrary(ShaderLibrary&&) noexcept = default;
+		ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+		ShaderLibrary& operator=(ShaderLibrary&&) noexcept = default;
+
 		[[nodiscard]] std::span<const std::string_view> getShaderNames() const;
-		[[nodiscard]] const ShaderBinary* getShaderBinaryByName(std::string_view name);
+		// All binaries in the order they are stored in, which includes every entry point of every shader.
+		[[nodiscard]] std::span<const ShaderBinary> getShaderBinaries() const;
+		[[nodiscard]] ContentHash getLayoutHash() const;
+		// The names of all groups in the order they are stored in. Shaders without a group are in the group "".
+		[[nodiscard]] std::span<const std::string_view> getGroupNames() const;
+		// The indices are the ones in the generated ID header of the library. This returns nullptr if the
+		// index is out of range.
+		[[nodiscard]] const ShaderBinary* getShaderBinaryByIndex(std::size_t index) const;
+		// If the shader is stored for several targets, this returns the first one that was declared.
+		[[nodiscard]] const ShaderBinary* getShaderBinaryByName(std::string_view name) const;
+		// For SPIR-V, this returns the highest version that is not above maxSpirvVersion, so that the
+		// highest version the device supports can be passed. The version is ignored for other languages.
+		[[nodiscard]] const ShaderBinary* getShaderBinaryForTarget(std::string_view name, ShaderLang lang, SPVVersion maxSpirvVersion) const;
 		// This will return the first shader in the binary that has the given shader stage, regardless
 		// of whether other shaders with the same stage are available.
-		[[nodiscard]] const ShaderBinary* getShaderBinaryByStage(ShaderStage stage);
+		[[nodiscard]] const ShaderBinary* getShaderBinaryByStage(ShaderStage stage) const;
+	};
+
+	// Loads the shaders of a library one group at a time, for example to only keep the shaders of the current
+	// level in memory. Every group is loaded with a single read of its contiguous range in the file.
+	class ShaderLibraryReader {
+		friend ShaderLibraryReader openShaderLibrary(const std::filesystem::path& path, ShaderLibraryReadFlags flags);
+
+		std::ifstream file;
+		ShaderLibraryReadFlags flags = ShaderLibraryReadFlags::None;
+		// The binaries of this have empty bytes and reflection until their group is loaded.
+		ShaderLibrary library;
+		std::vector<ShaderDescription> descriptions;
+		std::vector<ShaderGroupDescription> groups;
+		std::vector<bool> loadedGroups;
+		// The stored and decoded bytes of every loaded group.
+		std::vector<std::vector<std::byte>> groupStorage;
+		std::vector<std::vector<std::uint32_t>> decodedGroupStorage;
+
+		[[nodiscard]] std::optional<std::size_t> findGroup(std::string_view group) const;
+
+	public:
+		ShaderLibraryReader() = default;
+		ShaderLibraryReader(const ShaderLibraryReader&) = delete;
+		ShaderLibraryReader(ShaderLibraryReader&&) noexcept = default;
+		ShaderLibraryReader& operator=(const ShaderLibraryReader&) = delete;
+		ShaderLibraryReader& operator=(ShaderLibraryReader&&) noexcept = default;
+
+		// The names, stages and hashes of all binaries are available right after opening.
+		[[nodiscard]] const ShaderLibrary& getLibrary() const;
+		[[nodiscard]] bool isGroupLoaded(std::string_view group) const;
+		// Loading a group that is already loaded does nothing. Returns false if the group does not exist or
+		// could not be read, in which case its binaries stay empty.
+		[[nodiscard]] bool loadGroup(std::string_view group);
+		// Frees the memory of the group, which invalidates the bytes and reflection of its binaries.
+		void unloadGroup(std::string_view group);
+	};
+
+	// A single archive holding many libraries, so that the runtime only needs to open and read one file.
+	class ShaderBundle {
+		friend ShaderBundle readShaderBundleFromFile(const std::filesystem::path& path, ShaderLibraryReadFlags flags);
+
+		std::vector<std::byte> storage;
+		std::vector<std::string_view> libraryNames;
+		std::vector<ShaderLibrary> libraries;
+
+	public:
+		ShaderBundle() = default;
+		ShaderBundle(const ShaderBundle&) = delete;
+		ShaderBundle(ShaderBundle&&) noexcept = default;
+		ShaderBundle& operator=(const ShaderBundle&) = delete;
+		ShaderBundle& operator=(ShaderBundle&&) noexcept = default;
+
+		[[nodiscard]] std::span<const std::string_view> getLibraryNames() const;
+		[[nodiscard]] const ShaderLibrary* getLibraryByName(std::string_view libraryName) const;
+		// Shorthand for getLibraryByName(libraryName)->getShaderBinaryByName(shaderName).
+		[[nodiscard]] const ShaderBinary* getShaderBinary(std::string_view libraryName, std::string_view shaderName) const;
 	};
 } // namespace shaders
@@ -18,6 +18,11 @@ namespace shaders {
 		using EnumType = std::underlying_type_t<ShaderLang>;
 		return static_cast<ShaderLang>(static_cast<EnumType>(lhs) & static_cast<EnumType>(rhs));
 	}
+
+	constexpr ShaderLang operator|(ShaderLang lhs, ShaderLang rhs) {
+		using EnumType = std::underlying_type_t<ShaderLang>;
+		return static_cast<ShaderLang>(static_cast<EnumType>(lhs) | static_cast<EnumType>(rhs));
+	}
 	// clang-format on
 
 	// We do 1.3 to 1.6.
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <vector>
 
 #include <shaders/shader_constants.hpp>
 
+namespace simdjson::dom {
+	class parser;
+} // namespace simdjson::dom
+
 namespace shaders {
 	struct ShaderEntryPoint {
 		ShaderStage stage;
@@ -13,9 +19,14 @@ namespace shaders {
 	struct ShaderJsonDesc {
 		std::filesystem::path source;
 		ShaderLang lang;
+		// This can contain several languages, which are all generated from a single parse of the source.
 		ShaderLang target;
 		std::string name;
 		std::vector<ShaderEntryPoint> entryPoints;
+		// The group all entry points are stored in, see ShaderLibraryReader. This is optional.
+		std::string group;
+		// The SPIR-V versions to compile to, sorted from lowest to highest. This is never empty.
+		std::vector<SPVVersion> spirvVersions;
 	};
 
 	struct ShaderJson {
@@ -23,5 +34,21 @@ namespace shaders {
 		std::vector<ShaderJsonDesc> descriptions;
 	};
 
+	struct ShaderManifestEntry {
+		std::filesystem::path json;
+		// The name of the output library. If empty, the name from the JSON is used.
+		std::string outputName;
+	};
+
+	// A manifest lists many JSONs so that all of them can be processed by a single invocation.
+	struct ShaderManifest {
+		std::vector<ShaderManifestEntry> entries;
+		// The file to touch after all JSONs have been processed successfully. This is optional.
+		std::filesystem::path stamp;
+	};
+
 	[[nodiscard]] std::int32_t parseJson(std::filesystem::path& path, ShaderJson& shader);
+	// Parses the JSON reusing the given parser, which avoids reallocating its buffers for every file.
+	[[nodiscard]] std::int32_t parseJson(std::filesystem::path& path, ShaderJson& shader, simdjson::dom::parser& parser);
+	[[nodiscard]] std::int32_t parseManifest(const std::filesystem::path& path, ShaderManifest& manifest, simdjson::dom::parser& parser);
 } // namespace shaders
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <shaders/shader_binary.hpp>
+#include <shaders/shader_constants.hpp>
+
+// This header declares the operations that rearrange the entries of existing libraries without compiling anything.
+namespace shaders {
+	// Selects binaries of a library. A binary matches if its stage is in the stage mask, if it matches any of the
+	// include patterns and if it matches none of the exclude patterns. Empty masks and pattern lists match everything.
+	struct ShaderLibraryFilter {
+		std::underlying_type_t<ShaderStage> stageMask = 0;
+		// Glob patterns matched against "<shader name>:<entry point>" and "<shader name>:<entry point>@<target>", where
+		// * matches any sequence of characters and ? matches a single character. See getShaderTargetName for the targets.
+		std::vector<std::string> includePatterns = {};
+		std::vector<std::string> excludePatterns = {};
+	};
+
+	// The lowercase name of the target a binary was built for, which is the SPIR-V version like "spv_1_6" for SPIR-V
+	// and the language like "msl" otherwise. This tells apart the binaries of an entry point built for several targets.
+	[[nodiscard]] std::string getShaderTargetName(const ShaderBinary& binary);
+
+	[[nodiscard]] bool matchesGlobPattern(std::string_view string, std::string_view pattern);
+	[[nodiscard]] bool matchesShaderLibraryFilter(const ShaderBinary& binary, const ShaderLibraryFilter& filter);
+
+	// Copies a binary and its reflection data so that it can be passed to buildShaderLibrary again, which stores
+	// it with the same codec.
+	[[nodiscard]] ShaderInput copyShaderInput(const ShaderBinary& binary);
+
+	// Both return an empty vector if no binary is left. Merging fails if two libraries contain different
+	// binaries under the same shader name, entry point name and target, while identical ones are only included once.
+	[[nodiscard]] std::vector<std::byte> filterShaderLibrary(const ShaderLibrary& library, const ShaderLibraryFilter& filter);
+	[[nodiscard]] std::vector<std::byte> mergeShaderLibraries(std::span<const ShaderLibrary* const> libraries);
+
+	// Implements "shaderprocessor merge --output <library> <library>...".
+	[[nodiscard]] std::int32_t runMergeCommand(std::span<char*> args);
+	// Implements "shaderprocessor filter <library> --output <library> [--stages <stage,...>] [--include <pattern>]...
+	// [--exclude <pattern>]... [--keep-list <file>]", where the keep list contains one include pattern per line.
+	[[nodiscard]] std::int32_t runFilterCommand(std::span<char*> args);
+	// Implements "shaderprocessor split <library> [--output-dir <dir>] (--by-stage | --part <name>=<pattern>...)".
+	// Every part is written to "<library>_<name>.shader", and binaries matching no part to "<library>_other.shader".
+	[[nodiscard]] std::int32_t runSplitCommand(std::span<char*> args);
+
+	// Implements "shaderprocessor diff <old library> <new library> --output <patch>", see createShaderLibraryPatch.
+	[[nodiscard]] std::int32_t runDiffCommand(std::span<char*> args);
+	// Implements "shaderprocessor patch <library> <patch> [--output <library>]", which patches the library in place
+	// unless an output is given.
+	[[nodiscard]] std::int32_t runPatchCommand(std::span<char*> args);
+} // namespace shaders
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <shaders/content_hash.hpp>
+#include <shaders/shader_binary.hpp>
+
+// This header declares binary delta patches between two versions of a shader library.
+namespace shaders {
+	inline constinit const auto patchHeaderMagic = fourCharacterCode('!', 'S', 'B', 'P');
+
+	// The header is followed by a stream of operations that produce the new library from front to back. Each operation
+	// starts with a varint of (length << 1 | isCopy). A copy is followed by a zigzag varint of its source offset in
+	// the old library, relative to the end of the previous copy, while an add is followed by the literal bytes.
+	struct ShaderPatchHeader {
+		std::uint32_t magic;
+		std::uint16_t version;
+		std::uint16_t reserved;
+		// The content hashes of the complete libraries, so that a patch is never applied to the wrong library.
+		ContentHash baseHash;
+		ContentHash resultHash;
+		std::uint64_t resultSize;
+	};
+
+	// Unchanged shaders are copied from the old library as a whole, while changed shaders are delta encoded against
+	// the old library in blocks of SPIR-V words. Both libraries need to be valid and aligned like for
+	// readShaderLibraryFromMemory. Returns an empty vector on failure.
+	[[nodiscard]] std::vector<std::byte> createShaderLibraryPatch(std::span<const std::byte> oldLibrary, std::span<const std::byte> newLibrary);
+
+	// Replaces the library with the patched version. The library is left unchanged if the patch is malformed,
+	// was created for another library, or the result does not match the expected hash.
+	[[nodiscard]] bool applyShaderLibraryPatch(std::vector<std::byte>& library, std::span<const std::byte> patch);
+} // namespace shaders
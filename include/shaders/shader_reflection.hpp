@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace shaders {
+	// The values are identical to VkDescriptorType, so that they can be cast directly.
+	enum class DescriptorType : std::uint32_t {
+		Sampler = 0,
+		CombinedImageSampler = 1,
+		SampledImage = 2,
+		StorageImage = 3,
+		UniformTexelBuffer = 4,
+		StorageTexelBuffer = 5,
+		UniformBuffer = 6,
+		StorageBuffer = 7,
+		InputAttachment = 10,
+		AccelerationStructure = 1000150000,
+	};
+
+	enum class ComponentType : std::uint32_t {
+		Unknown = 0,
+		Float16,
+		Float32,
+		Float64,
+		Int16,
+		Int32,
+		Int64,
+		UInt16,
+		UInt32,
+		UInt64,
+	};
+
+	struct ReflectedDescriptorBinding {
+		std::uint32_t set;
+		std::uint32_t binding;
+		DescriptorType type;
+		// The amount of descriptors in the binding. This is 0 for runtime sized arrays.
+		std::uint32_t count;
+	};
+
+	struct ReflectedPushConstantRange {
+		std::uint32_t offset;
+		std::uint32_t size;
+	};
+
+	struct ReflectedVertexInput {
+		std::uint32_t location;
+		ComponentType componentType;
+		std::uint32_t componentCount;
+	};
+
+	// The header of the reflection section of each shader, which is directly followed by the arrays
+	// of descriptor bindings, push constant ranges and vertex inputs.
+	struct ShaderReflectionHeader {
+		std::array<std::uint32_t, 3> workgroupSize;
+		std::uint32_t descriptorBindingCount;
+		std::uint32_t pushConstantRangeCount;
+		std::uint32_t vertexInputCount;
+	};
+
+	// The reflection data of a single shader entry point, as gathered by the shader processor.
+	struct ShaderReflectionData {
+		std::array<std::uint32_t, 3> workgroupSize;
+		std::vector<ReflectedDescriptorBinding> descriptorBindings;
+		std::vector<ReflectedPushConstantRange> pushConstantRanges;
+		std::vector<ReflectedVertexInput> vertexInputs;
+	};
+
+	// A view of the reflection section of a shader inside of a ShaderLibrary. All spans point directly
+	// into the library's memory, so nothing is parsed or copied when loading.
+	struct ShaderReflection {
+		// The local workgroup size. This is all zeroes for stages other than compute, task and mesh.
+		std::array<std::uint32_t, 3> workgroupSize;
+		std::span<const ReflectedDescriptorBinding> descriptorBindings;
+		std::span<const ReflectedPushConstantRange> pushConstantRanges;
+		std::span<const ReflectedVertexInput> vertexInputs;
+	};
+} // namespace shaders
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <shaders/shader_binary.hpp>
+#include <shaders/shader_constants.hpp>
+
+// This header declares the size and instruction count reports used to track the cost of shader libraries.
+namespace shaders {
+	struct ShaderReportEntry {
+		std::string shaderName;
+		std::string entryPoint;
+		ShaderStage stage;
+		ShaderLang lang;
+		// An entry point can be stored for several SPIR-V versions. This is only meaningful for SPIR-V.
+		SPVVersion spirvVersion;
+		std::uint64_t byteSize;
+		// The following are only counted for SPIR-V, and are zero for every other language.
+		std::uint32_t instructionCount = 0;
+		std::uint32_t functionCount = 0;
+		// The bound of all result IDs, which is a rough proxy for the register pressure of the shader.
+		std::uint32_t idBound = 0;
+	};
+
+	struct ShaderReport {
+		std::vector<ShaderReportEntry> entries;
+	};
+
+	[[nodiscard]] ShaderReport createShaderReport(const ShaderLibrary& library);
+	[[nodiscard]] std::string serializeShaderReport(const ShaderReport& report);
+	// Reads either a report written by serializeShaderReport or a shader library, which is reported first.
+	[[nodiscard]] std::int32_t readShaderReport(const std::filesystem::path& path, ShaderReport& report);
+
+	// Prints the size of every entry and, if given, how it changed compared to the baseline. Returns false if the
+	// byte size or instruction count of any entry, or the total byte size, grew by more than maxGrowthPercent.
+	[[nodiscard]] bool printShaderReport(const ShaderReport& report, const ShaderReport* baseline, double maxGrowthPercent);
+
+	// Implements "shaderprocessor report <library> [--baseline <library|report>] [--output <report>] [--max-growth <percent>]".
+	[[nodiscard]] std::int32_t runReportCommand(std::span<char*> args);
+} // namespace shaders
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// This header declares a compact encoding of SPIR-V modules in the spirit of SMOL-V. Opcodes and word counts are
+// packed into a single varint, result IDs are stored as the difference to the previous result ID, and operands of
+// instructions with a result are stored relative to it, so that references to recent results take a single byte.
+// Every word is kept, so decoding produces the exact original module.
+namespace shaders {
+	// Returns std::nullopt if the bytes are not a well-formed sequence of SPIR-V instructions.
+	[[nodiscard]] std::optional<std::vector<std::byte>> encodeCompactSpirv(std::span<const std::byte> spirv);
+
+	// Returns the word count of the decoded module, which is stored at the start of the encoded bytes.
+	[[nodiscard]] std::optional<std::size_t> getCompactSpirvWordCount(std::span<const std::byte> encoded);
+	// Decodes into the given words, which need to be exactly as many as getCompactSpirvWordCount returned.
+	[[nodiscard]] bool decodeCompactSpirv(std::span<const std::byte> encoded, std::span<std::uint32_t> words);
+} // namespace shaders
@@ -1,10 +1,14 @@
 #include <bit>
+#include <cassert>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <sstream>
 
 #include <SPIRV/GlslangToSpv.h>
 #include <SPIRV/SpvTools.h>
+#include <glslang/MachineIndependent/localintermediate.h>
 #include <glslang/Public/ShaderLang.h>
 
 #include <shaders/compile.hpp>
@@ -15,9 +19,10 @@ namespace fs = std::filesystem;
 
 class DefaultFileIncluder : public glslang::TShader::Includer {
 	fs::path sourcePath;
+	std::vector<fs::path>& includes;
 
 public:
-	explicit DefaultFileIncluder(fs::path sourcePath) : sourcePath(std::move(sourcePath)) {};
+	DefaultFileIncluder(fs::path sourcePath, std::vector<fs::path>& includes) : sourcePath(std::move(sourcePath)), includes(includes) {};
 
 	~DefaultFileIncluder() override = default;
 
@@ -30,6 +35,7 @@ public:
 	IncludeResult* includeLocal(const char* headerName, const char* includerName, size_t inclusionDepth) override {
 		// TODO: Respect the relative directory of included files.
 		auto fullPath = sourcePath / fs::path { headerName };
+		includes.emplace_back(fullPath);
 
 		std::ifstream file(fullPath, std::ios_base::binary | std::ios_base::ate);
 
@@ -37,7 +43,10 @@ public:
 		char* content = new char[length];
 		file.seekg(0, std::ifstream::beg);
 		file.read(content, length);
-		return new IncludeResult(fullPath.string(), content, length, content);
+
+		// The name ends up in the #line directives of the preprocessed source, so it is kept relative to the
+		// source for the jobs to be identical on every machine.
+		return new IncludeResult(fs::path { headerName }.generic_string(), content, length, content);
 	}
 
 	void releaseInclude(IncludeResult* result) override {
@@ -99,6 +108,11 @@ constexpr glslang::EShTargetLanguageVersion getGlslangSpvVersion(shaders::SPVVer
 	}
 }
 
+// Make these configurable in the future.
+constexpr auto glslVersion = 460U;
+constexpr auto glslProfile = ENoProfile;
+constexpr auto messages = static_cast<EShMessages>(EShMsgDefault | EShMsgSpvRules | EShMsgVulkanRules | EShMsgEnhanced);
+
 template <typename T>
 // clang-format off
 requires requires(T t) {
@@ -123,42 +137,69 @@ void printGlslangError(const std::string& filePath, T* shader) {
 	}
 }
 
-std::vector<std::uint32_t> shaders::compileGlsl(const shaders::ShaderJsonDesc& shaderStage) {
+namespace {
+	std::once_flag glslangOnce;
+	bool glslangInitialized = false;
+} // namespace
+
+void shaders::initializeGlslang() {
+	std::call_once(glslangOnce, []() {
+		glslang::InitializeProcess();
+		glslangInitialized = true;
+	});
+}
+
+void shaders::finalizeGlslang() {
+	if (glslangInitialized) {
+		glslang::FinalizeProcess();
+	}
+}
+
+std::optional<std::string> shaders::preprocessGlsl(const shaders::ShaderJsonDesc& shaderStage, const std::string& glsl,
+                                                   std::vector<fs::path>& includes) {
 	// glslang only allows compiling a single shader called "main"
 	assert(shaderStage.entryPoints.size() == 1);
 	assert(shaderStage.entryPoints.front().name == "main");
-	const auto& entryPoint = shaderStage.entryPoints.front();
-
-	// Make this configurable in the future.
-	constexpr auto spvVersion = shaders::SPVVersion::SPV_1_3;
-	constexpr auto glslVersion = 460U;
-	constexpr auto glslProfile = ENoProfile;
-	constexpr auto messages = static_cast<EShMessages>(EShMsgDefault | EShMsgSpvRules | EShMsgVulkanRules | EShMsgEnhanced);
-	auto stage = getGlslangStage(entryPoint.stage);
+	initializeGlslang();
+	auto stage = getGlslangStage(shaderStage.entryPoints.front().stage);
 
-	// Read the file as a string.
 	auto shaderSource = shaderStage.source.string();
-	std::string glsl = readFileAsString(shaderStage.source);
 	const auto* sourcePointer = glsl.data();
 
 	auto shader = std::make_unique<glslang::TShader>(stage);
 	shader->setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, glslVersion);
 	shader->setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_1);
-	shader->setEnvTarget(glslang::EshTargetSpv, getGlslangSpvVersion(spvVersion));
+	shader->setEnvTarget(glslang::EshTargetSpv, getGlslangSpvVersion(shaderStage.spirvVersions.front()));
 	shader->setStrings(&sourcePointer, 1);
 
 	std::string preprocessedGLSL;
-	{
-		DefaultFileIncluder includer(shaderStage.source.parent_path());
-		if (!shader->preprocess(&shaders::DefaultTBuiltInResource, glslVersion, glslProfile, true, false, messages, &preprocessedGLSL,
-		                        includer)) {
-			printGlslangError(shaderSource, shader.get());
-			shader.reset();
-			return {};
-		}
+	DefaultFileIncluder includer(shaderStage.source.parent_path(), includes);
+	if (!shader->preprocess(&shaders::DefaultTBuiltInResource, glslVersion, glslProfile, true, false, messages, &preprocessedGLSL,
+	                        includer)) {
+		printGlslangError(shaderSource, shader.get());
+		return std::nullopt;
 	}
+	return preprocessedGLSL;
+}
+
+std::vector<std::vector<std::uint32_t>> shaders::compileGlsl(const shaders::CompileJob& job) {
+	assert(job.lang == ShaderLang::GLSL);
+	assert(job.entryPoints.size() == 1);
+	assert(!job.spirvVersions.empty());
+	initializeGlslang();
+	const auto& entryPoint = job.entryPoints.front();
+	auto stage = getGlslangStage(entryPoint.stage);
+
+	// The job only contains the preprocessed source, so no includer is required.
+	const auto& shaderSource = job.sourcePath;
+	const auto* sourcePointer = job.source.data();
 
-	sourcePointer = preprocessedGLSL.data();
+	auto shader = std::make_unique<glslang::TShader>(stage);
+	shader->setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, glslVersion);
+	shader->setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_1);
+	// The source is parsed and linked for the lowest version only, and the resulting AST is then translated
+	// once for every version.
+	shader->setEnvTarget(glslang::EshTargetSpv, getGlslangSpvVersion(job.spirvVersions.front()));
 	shader->setStrings(&sourcePointer, 1);
 	if (!shader->parse(&shaders::DefaultTBuiltInResource, glslVersion, glslProfile, true, false, messages)) {
 		printGlslangError(shaderSource, shader.get());
@@ -176,15 +217,22 @@ std::vector<std::uint32_t> shaders::compileGlsl(const shaders::ShaderJsonDesc& s
 		return {};
 	}
 
-	std::vector<std::uint32_t> spirv;
-	spv::SpvBuildLogger spvBuildLogger;
-	{
+	std::vector<std::vector<std::uint32_t>> results;
+	results.reserve(job.spirvVersions.size());
+	auto* intermediate = program->getIntermediate(stage);
+	for (auto version : job.spirvVersions) {
+		// The SPIR-V version only affects code generation, which reads it from the intermediate.
+		auto spv = intermediate->getSpv();
+		spv.spv = getGlslangSpvVersion(version);
+		intermediate->setSpv(spv);
+
+		auto& spirv = results.emplace_back();
+		spv::SpvBuildLogger spvBuildLogger;
 		glslang::SpvOptions spvOptions;
-		const auto* intermediate = program->getIntermediate(stage);
+		// Debug info would embed the source paths, which differ between machines.
+		spvOptions.generateDebugInfo = false;
 		glslang::GlslangToSpv(*intermediate, spirv, &spvBuildLogger, &spvOptions);
-	}
 
-	{
 		auto spvMessages = spvBuildLogger.getAllMessages();
 		if (!spvMessages.empty()) {
 			std::string line;
@@ -195,5 +243,5 @@ std::vector<std::uint32_t> shaders::compileGlsl(const shaders::ShaderJsonDesc& s
 		}
 	}
 
-	return spirv;
+	return results;
 }
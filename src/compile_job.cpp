@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <shaders/compile.hpp>
+
+namespace {
+	// Calls function with every index below count, spread over threadCount threads including the calling one.
+	// With a jobserver, every thread but the calling one holds a token while calling function, as the calling
+	// thread runs on the token that make implicitly gave to this process.
+	template <typename Function>
+	void runOnThreads(std::size_t count, std::uint32_t threadCount, const shaders::JobServerClient* jobServer, Function&& function) {
+		std::atomic<std::size_t> next = 0;
+		auto run = [&]() {
+			for (auto i = next++; i < count; i = next++) {
+				function(i);
+			}
+		};
+		auto runWithTokens = [&]() {
+			if (jobServer == nullptr) {
+				run();
+				return;
+			}
+
+			while (auto token = jobServer->acquire([&]() { return next < count; })) {
+				if (auto i = next++; i < count) {
+					function(i);
+				}
+				jobServer->release(*token);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		auto usedThreads = std::min<std::size_t>(std::max<std::uint32_t>(threadCount, 1U), count);
+		for (std::size_t i = 1; i < usedThreads; ++i) {
+			threads.emplace_back(runWithTokens);
+		}
+		run();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+} // namespace
+
+bool shaders::canCompileToSpirv(ShaderLang lang) {
+	switch (lang) {
+#ifdef WITH_GLSLANG_SHADERS
+		case ShaderLang::GLSL:
+			return true;
+#endif
+#ifdef WITH_SLANG_SHADERS
+		case ShaderLang::SLANG:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+void shaders::initializeCompiler(ShaderLang lang) {
+	switch (lang) {
+#ifdef WITH_GLSLANG_SHADERS
+		case ShaderLang::GLSL:
+			initializeGlslang();
+			break;
+#endif
+#ifdef WITH_SLANG_SHADERS
+		case ShaderLang::SLANG:
+			getSlangSession();
+			break;
+#endif
+		default:
+			break;
+	}
+}
+
+void shaders::finalizeCompilers() {
+#ifdef WITH_SPIRV_CROSS
+	destroySpvcContext();
+#endif
+#ifdef WITH_SLANG_SHADERS
+	destroySlangSession();
+#endif
+#ifdef WITH_GLSLANG_SHADERS
+	finalizeGlslang();
+#endif
+}
+
+std::optional<shaders::CompileJob> shaders::createCompileJob(const ShaderJsonDesc& desc, std::string source) {
+	CompileJob job = {
+		.lang = desc.lang,
+		.sourcePath = desc.source.string(),
+		.entryPoints = desc.entryPoints,
+		.spirvVersions = desc.spirvVersions,
+	};
+
+	switch (desc.lang) {
+#ifdef WITH_GLSLANG_SHADERS
+		case ShaderLang::GLSL: {
+			// Resolving all includes here makes the job independent of the filesystem.
+			auto preprocessed = preprocessGlsl(desc, source, job.includes);
+			if (!preprocessed.has_value()) {
+				return std::nullopt;
+			}
+			job.source = std::move(*preprocessed);
+			break;
+		}
+#endif
+		default: {
+			job.source = std::move(source);
+			break;
+		}
+	}
+	return job;
+}
+
+std::vector<std::optional<shaders::CompileJob>> shaders::createCompileJobs(std::span<const ShaderJsonDesc* const> descs,
+                                                                           std::span<std::string> sources, std::uint32_t threadCount,
+                                                                           const JobServerClient* jobServer) {
+	std::vector<std::optional<CompileJob>> jobs(descs.size());
+	runOnThreads(descs.size(), threadCount, jobServer, [&](std::size_t i) { jobs[i] = createCompileJob(*descs[i], std::move(sources[i])); });
+	return jobs;
+}
+
+shaders::CompileJobResult shaders::executeCompileJob(const CompileJob& job) {
+	switch (job.lang) {
+#ifdef WITH_GLSLANG_SHADERS
+		case ShaderLang::GLSL:
+			return compileGlsl(job);
+#endif
+#ifdef WITH_SLANG_SHADERS
+		case ShaderLang::SLANG: {
+			// The slang session is not fully threadsafe.
+			static std::mutex slangMutex;
+			std::lock_guard lock(slangMutex);
+			return compileSlang(job);
+		}
+#endif
+		default: {
+			std::cerr << ">> Did not find a method to compile shader from source: " << job.sourcePath << std::endl;
+			return {};
+		}
+	}
+}
+
+std::vector<shaders::CompileJobResult> shaders::executeLocalCompileJobs(std::span<const CompileJob> jobs, std::span<const std::size_t> order,
+                                                                        std::uint32_t threadCount, std::span<std::chrono::microseconds> durations,
+                                                                        const JobServerClient* jobServer) {
+	std::vector<CompileJobResult> results(jobs.size());
+	runOnThreads(order.size(), threadCount, jobServer, [&](std::size_t i) {
+		auto jobIndex = order[i];
+		auto start = std::chrono::steady_clock::now();
+		results[jobIndex] = executeCompileJob(jobs[jobIndex]);
+		durations[jobIndex] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+	});
+	return results;
+}
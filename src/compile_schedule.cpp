@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <string_view>
+
+#include <magic_enum.hpp>
+
+#include <shaders/compile_schedule.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	// The first line of the file. Files without it stored milliseconds instead of microseconds, and are ignored.
+	constexpr std::string_view timingsHeader = "shaderprocessor-timings 2";
+} // namespace
+
+std::string shaders::getCompileJobKey(const CompileJob& job) {
+	std::string key { magic_enum::enum_name(job.lang) };
+	for (const auto& entryPoint : job.entryPoints) {
+		key += ':';
+		key += entryPoint.name;
+	}
+	// Every additional version adds to the compile time of the job.
+	for (auto version : job.spirvVersions) {
+		key += '@';
+		key += magic_enum::enum_name(version);
+	}
+	key += ' ';
+	key += job.sourcePath;
+	return key;
+}
+
+shaders::CompileTimings shaders::CompileTimings::readFromFile(const fs::path& path) {
+	CompileTimings timings;
+	std::ifstream file(path);
+	std::string header;
+	if (!std::getline(file, header) || header != timingsHeader) {
+		return timings;
+	}
+
+	std::uint32_t microseconds = 0;
+	std::string key;
+	while (file >> microseconds && file.get() == ' ' && std::getline(file, key)) {
+		timings.microseconds.insert_or_assign(std::move(key), microseconds);
+	}
+	return timings;
+}
+
+void shaders::CompileTimings::writeToFile(const fs::path& path) const {
+	// Sorted by key, so that the file only changes if any timing changed.
+	std::vector<std::pair<std::string_view, std::uint32_t>> entries(microseconds.begin(), microseconds.end());
+	std::sort(entries.begin(), entries.end());
+
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	file << timingsHeader << '\n';
+	for (const auto& [key, value] : entries) {
+		file << value << ' ' << key << '\n';
+	}
+}
+
+void shaders::CompileTimings::record(const CompileJob& job, std::chrono::microseconds duration) {
+	microseconds.insert_or_assign(getCompileJobKey(job), static_cast<std::uint32_t>(duration.count()));
+}
+
+std::optional<std::uint32_t> shaders::CompileTimings::find(const CompileJob& job) const {
+	auto it = microseconds.find(getCompileJobKey(job));
+	if (it == microseconds.end()) {
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+std::vector<std::size_t> shaders::getCompileJobOrder(std::span<const CompileJob> jobs, const CompileTimings& timings) {
+	// The known timings give the compile time in microseconds per byte, which is used to estimate the others.
+	// Without any known timing, all estimates are in bytes, which still orders the jobs correctly.
+	std::vector<std::optional<std::uint32_t>> knownTimings(jobs.size());
+	double knownBytes = 0.0;
+	double knownMicroseconds = 0.0;
+	for (std::size_t i = 0; i < jobs.size(); ++i) {
+		knownTimings[i] = timings.find(jobs[i]);
+		if (knownTimings[i].has_value()) {
+			knownBytes += static_cast<double>(jobs[i].source.size());
+			knownMicroseconds += static_cast<double>(*knownTimings[i]);
+		}
+	}
+	auto microsecondsPerByte = knownBytes > 0.0 && knownMicroseconds > 0.0 ? knownMicroseconds / knownBytes : 1.0;
+
+	std::vector<double> estimates(jobs.size());
+	for (std::size_t i = 0; i < jobs.size(); ++i) {
+		estimates[i] = knownTimings[i].has_value() ? static_cast<double>(*knownTimings[i])
+		                                           : static_cast<double>(jobs[i].source.size()) * microsecondsPerByte;
+	}
+
+	// A stable sort keeps the declaration order for jobs with equal estimates.
+	std::vector<std::size_t> order(jobs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return estimates[a] > estimates[b]; });
+	return order;
+}
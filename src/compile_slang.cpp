@@ -1,12 +1,36 @@
-#include <fstream>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 
 #include <slang.h>
 
 #include <shaders/compile.hpp>
 
+namespace fs = std::filesystem;
+
+namespace {
+	std::once_flag slangSessionOnce;
+	SlangSession* slangSession = nullptr;
+} // namespace
+
+SlangSession* shaders::getSlangSession() {
+	std::call_once(slangSessionOnce, []() { slangSession = spCreateSession(); });
+	return slangSession;
+}
+
+void shaders::destroySlangSession() {
+	if (slangSession != nullptr) {
+		spDestroySession(slangSession);
+	}
+}
+
 SlangStage getSlangStage(shaders::ShaderStage inputStage) {
-	using namespace ks;
-	VERIFY(std::popcount(static_cast<std::std::uint16_t>(inputStage)) == 1);
+	using namespace ::shaders;
+	assert(std::popcount(static_cast<std::uint16_t>(inputStage)) == 1);
 
 	switch (inputStage) {
 		case ShaderStage::Vertex:
@@ -32,41 +56,59 @@ SlangStage getSlangStage(shaders::ShaderStage inputStage) {
 		case ShaderStage::Callable:
 			return SLANG_STAGE_CALLABLE;
 		default:
-			kl::throwError("[slang] Unrecognized shader stage type: {}.", static_cast<std::uint16_t>(inputStage));
+			throw std::runtime_error(
+				std::string { "[slang] Unrecognized shader stage type: " } + std::to_string(static_cast<std::uint16_t>(inputStage)));
 	}
 }
 
-std::vector<std::vector<std::uint32_t>> shaders::compileSlang(const ::shaders::ShaderJsonStage& shaderStage) {
-	auto* session = static_cast<SlangSession*>(shaders::slangSession);
+const char* getSlangSpvProfile(shaders::SPVVersion spvVersion) {
+	using namespace ::shaders;
+	switch (spvVersion) {
+		case SPVVersion::SPV_1_3:
+			return "spirv_1_3";
+		case SPVVersion::SPV_1_4:
+			return "spirv_1_4";
+		case SPVVersion::SPV_1_5:
+			return "spirv_1_5";
+		case SPVVersion::SPV_1_6:
+			return "spirv_1_6";
+		default:
+			throw std::runtime_error(
+				std::string { "[slang] Unrecognized SPIR-V version: " } + std::to_string(static_cast<std::underlying_type_t<SPVVersion>>(spvVersion)));
+	}
+}
+
+std::vector<std::vector<std::uint32_t>> shaders::compileSlang(const shaders::CompileJob& job) {
+	auto* session = getSlangSession();
 
 	constexpr SlangCompileTarget compileTarget = SLANG_SPIRV;
 	constexpr SlangSourceLanguage source = SLANG_SOURCE_LANGUAGE_SLANG;
 
 	auto* request = spCreateCompileRequest(session);
-	auto target = spAddCodeGenTarget(request, compileTarget);
 
 	// Setup some settings. We force the matrix layout to match GLSL.
-	spAddSearchPath(request, shaderStage.source.parent_path().string().c_str());
+	// The search path only resolves imports if the job is executed on the machine that created it.
+	auto sourcePath = fs::path { job.sourcePath };
+	spAddSearchPath(request, sourcePath.parent_path().string().c_str());
 	spSetDebugInfoLevel(request, SLANG_DEBUG_INFO_LEVEL_NONE);
 	spSetOptimizationLevel(request, SLANG_OPTIMIZATION_LEVEL_HIGH);
 	spSetMatrixLayoutMode(request, SLANG_MATRIX_LAYOUT_COLUMN_MAJOR);
-	spSetTargetForceGLSLScalarBufferLayout(request, target, true);
-
-	// Read the file as a string.
-	std::string glsl;
-	{
-		std::ifstream fileInput(shaderStage.source);
-		std::stringstream fileContents;
-		fileContents << fileInput.rdbuf();
-		glsl = fileContents.str();
+
+	// Every version is a separate target of the same request, so that the source is only parsed and checked once.
+	std::vector<int> targets;
+	for (auto version : job.spirvVersions) {
+		auto target = spAddCodeGenTarget(request, compileTarget);
+		spSetTargetProfile(request, target, spFindProfile(session, getSlangSpvProfile(version)));
+		spSetTargetForceGLSLScalarBufferLayout(request, target, true);
+		targets.emplace_back(target);
 	}
 
-	auto filename = shaderStage.source.filename().string();
+	auto filename = sourcePath.filename().string();
 	auto tuIndex = spAddTranslationUnit(request, source, filename.c_str());
-	spAddTranslationUnitSourceString(request, tuIndex, filename.c_str(), glsl.data());
+	spAddTranslationUnitSourceString(request, tuIndex, filename.c_str(), job.source.c_str());
 
 	std::vector<std::int32_t> entryPoints;
-	for (const auto& entry : shaderStage.entryPoints) {
+	for (const auto& entry : job.entryPoints) {
 		auto stage = getSlangStage(entry.stage);
 		entryPoints.emplace_back(spAddEntryPoint(request, tuIndex, entry.name.c_str(), stage));
 	}
@@ -78,24 +120,32 @@ std::vector<std::vector<std::uint32_t>> shaders::compileSlang(const ::shaders::S
 		std::istringstream ss(diagnostics);
 		std::string line;
 		while (std::getline(ss, line)) {
-			kl::err("[slang] {}: {}", shaderStage.source.filename().string(), line);
+			std::cerr << ">> [slang] " << filename << ": " << line << std::endl;
 		}
+		spDestroyCompileRequest(request);
 		return {};
 	}
 
 	std::vector<std::vector<std::uint32_t>> results;
-	results.reserve(entryPoints.size());
+	results.reserve(entryPoints.size() * targets.size());
 	for (auto& entryPoint : entryPoints) {
-		// Get the shader output code for this entry point.
-		size_t resultSize = 0;
-		const auto* data = spGetEntryPointCode(request, entryPoint, &resultSize);
-		VERIFY(resultSize > 0 && resultSize % 4 == 0); // SPIR-V requirements.
-
-		// We have to reallocate the data as slang automatically deletes
-		// the given data.
-		std::vector<std::uint32_t> result(resultSize);
-		std::memcpy(result.data(), data, resultSize);
-		results.emplace_back(std::move(result));
+		for (auto target : targets) {
+			// Get the shader output code for this entry point.
+			ISlangBlob* blob = nullptr;
+			if (SLANG_FAILED(spGetEntryPointCodeBlob(request, entryPoint, target, &blob)) || blob == nullptr) {
+				std::cerr << ">> [slang] " << filename << ": Failed to get the code for entry point " << entryPoint << std::endl;
+				results.emplace_back();
+				continue;
+			}
+			auto resultSize = blob->getBufferSize();
+			assert(resultSize > 0 && resultSize % 4 == 0); // SPIR-V requirements.
+
+			// We have to copy the data as the blob is released.
+			std::vector<std::uint32_t> result(resultSize / sizeof(std::uint32_t));
+			std::memcpy(result.data(), blob->getBufferPointer(), resultSize);
+			blob->release();
+			results.emplace_back(std::move(result));
+		}
 	}
 
 	spDestroyCompileRequest(request);
@@ -1,11 +1,31 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <string>
+#include <tuple>
 
 // We're using the C API from the submodule, as the C++ API is not 100% stable
 #include <spirv_cross_c.h>
 
 #include <shaders/compile.hpp>
 
+namespace {
+	std::once_flag spvcContextOnce;
+	spvc_context spvcContext = nullptr;
+
+	// The context keeps every parsed module and compiler until its allocations are released, so each call
+	// releases them again once its results have been copied out.
+	struct SpvcAllocationScope {
+		spvc_context context;
+
+		~SpvcAllocationScope() {
+			spvc_context_release_allocations(context);
+		}
+	};
+} // namespace
+
 void printSpvcError(void* userData, const char* error) {
 	std::cerr << "SPIRV-Cross: " << error << std::endl;
 }
@@ -16,18 +36,94 @@ void checkSpvcReturn(spvc_result result, const std::string& message) {
 	}
 }
 
-std::string shaders::generateMslFromSpv(std::span<std::byte> spirv) {
-	spvc_compiler compiler = nullptr;
-	spvc_compiler_options options = nullptr;
-	spvc_parsed_ir ir = nullptr;
+spvc_context shaders::getSpvcContext() {
+	std::call_once(spvcContextOnce, []() {
+		spvc_context_create(&spvcContext);
+		spvc_context_set_error_callback(spvcContext, printSpvcError, nullptr);
+	});
+	return spvcContext;
+}
 
-	spvc_context_create(&spvcContext);
+void shaders::destroySpvcContext() {
+	if (spvcContext != nullptr) {
+		spvc_context_release_allocations(spvcContext);
+		spvc_context_destroy(spvcContext);
+	}
+}
+
+SpvExecutionModel getSpvExecutionModel(shaders::ShaderStage stage) {
+	using namespace ::shaders;
+	switch (stage) {
+		case ShaderStage::Vertex:
+			return SpvExecutionModelVertex;
+		case ShaderStage::Fragment:
+			return SpvExecutionModelFragment;
+		case ShaderStage::Geometry:
+			return SpvExecutionModelGeometry;
+		case ShaderStage::Compute:
+			return SpvExecutionModelGLCompute;
+		case ShaderStage::Mesh:
+			return SpvExecutionModelMeshEXT;
+		case ShaderStage::Task:
+			return SpvExecutionModelTaskEXT;
+		case ShaderStage::RayGen:
+			return SpvExecutionModelRayGenerationKHR;
+		case ShaderStage::ClosestHit:
+			return SpvExecutionModelClosestHitKHR;
+		case ShaderStage::Miss:
+			return SpvExecutionModelMissKHR;
+		case ShaderStage::AnyHit:
+			return SpvExecutionModelAnyHitKHR;
+		case ShaderStage::Intersect:
+			return SpvExecutionModelIntersectionKHR;
+		case ShaderStage::Callable:
+			return SpvExecutionModelCallableKHR;
+		default:
+			return SpvExecutionModelMax;
+	}
+}
 
-	spvc_context_set_error_callback(spvcContext, printSpvcError, nullptr);
+shaders::ComponentType getComponentType(spvc_basetype baseType) {
+	using namespace ::shaders;
+	switch (baseType) {
+		case SPVC_BASETYPE_FP16:
+			return ComponentType::Float16;
+		case SPVC_BASETYPE_FP32:
+			return ComponentType::Float32;
+		case SPVC_BASETYPE_FP64:
+			return ComponentType::Float64;
+		case SPVC_BASETYPE_INT16:
+			return ComponentType::Int16;
+		case SPVC_BASETYPE_INT32:
+			return ComponentType::Int32;
+		case SPVC_BASETYPE_INT64:
+			return ComponentType::Int64;
+		case SPVC_BASETYPE_UINT16:
+			return ComponentType::UInt16;
+		case SPVC_BASETYPE_UINT32:
+			return ComponentType::UInt32;
+		case SPVC_BASETYPE_UINT64:
+			return ComponentType::UInt64;
+		default:
+			return ComponentType::Unknown;
+	}
+}
 
-	spvc_context_parse_spirv(spvcContext, reinterpret_cast<const std::uint32_t*>(spirv.data()), spirv.size_bytes(), &ir);
-	spvc_context_create_compiler(spvcContext, SPVC_BACKEND_MSL, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler);
+std::string shaders::generateMslFromSpv(std::span<const std::byte> spirv, const ShaderEntryPoint& entryPoint) {
+	spvc_parsed_ir ir = nullptr;
+	spvc_compiler compiler = nullptr;
+	spvc_compiler_options options = nullptr;
+	auto* context = getSpvcContext();
+	SpvcAllocationScope allocationScope { context };
+	if (spvc_context_parse_spirv(context, reinterpret_cast<const SpvId*>(spirv.data()), spirv.size_bytes() / sizeof(SpvId), &ir)
+	        != SPVC_SUCCESS
+	    || spvc_context_create_compiler(context, SPVC_BACKEND_MSL, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler) != SPVC_SUCCESS) {
+		std::cerr << "SPIRV-Cross: Failed to parse SPIR-V for MSL: " << entryPoint.name << std::endl;
+		return {};
+	}
 
+	checkSpvcReturn(spvc_compiler_set_entry_point(compiler, entryPoint.name.c_str(), getSpvExecutionModel(entryPoint.stage)),
+	                "Failed to set entry point");
 	spvc_compiler_create_compiler_options(compiler, &options);
 	spvc_compiler_options_set_uint(options, SPVC_COMPILER_OPTION_MSL_VERSION, SPVC_MAKE_MSL_VERSION(3, 0, 0));
 	spvc_compiler_options_set_bool(options, SPVC_COMPILER_OPTION_MSL_ARGUMENT_BUFFERS, true);
@@ -41,12 +137,130 @@ std::string shaders::generateMslFromSpv(std::span<std::byte> spirv) {
 		return {};
 	}
 
-	std::string msl(tempString);
-
-	return msl;
+	return std::string { tempString };
 }
 
-std::string shaders::generateMslFromSpv(const ::shaders::ShaderJsonDesc& shaderJsonStage) {
-	auto spirv = readFileAsBytes(shaderJsonStage.source);
-	return generateMslFromSpv(spirv);
+shaders::ShaderReflectionData shaders::reflectSpirv(std::span<const std::byte> spirv, const ShaderEntryPoint& entryPoint) {
+	ShaderReflectionData reflection = {};
+
+	spvc_parsed_ir ir = nullptr;
+	spvc_compiler compiler = nullptr;
+	auto* context = getSpvcContext();
+	SpvcAllocationScope allocationScope { context };
+	if (spvc_context_parse_spirv(context, reinterpret_cast<const SpvId*>(spirv.data()), spirv.size_bytes() / sizeof(SpvId), &ir)
+	        != SPVC_SUCCESS
+	    || spvc_context_create_compiler(context, SPVC_BACKEND_NONE, ir, SPVC_CAPTURE_MODE_TAKE_OWNERSHIP, &compiler) != SPVC_SUCCESS) {
+		std::cerr << "SPIRV-Cross: Failed to parse SPIR-V for reflection: " << entryPoint.name << std::endl;
+		return reflection;
+	}
+
+	// Only the resources used by the given entry point are of interest.
+	auto executionModel = getSpvExecutionModel(entryPoint.stage);
+	checkSpvcReturn(spvc_compiler_set_entry_point(compiler, entryPoint.name.c_str(), executionModel), "Failed to set entry point");
+
+	spvc_set activeVariables = nullptr;
+	spvc_resources resources = nullptr;
+	checkSpvcReturn(spvc_compiler_get_active_interface_variables(compiler, &activeVariables), "Failed to get interface variables");
+	if (spvc_compiler_create_shader_resources_for_active_variables(compiler, &resources, activeVariables) != SPVC_SUCCESS) {
+		return reflection;
+	}
+
+	auto getResources = [&resources](spvc_resource_type type) -> std::span<const spvc_reflected_resource> {
+		const spvc_reflected_resource* list = nullptr;
+		size_t count = 0;
+		if (spvc_resources_get_resource_list_for_type(resources, type, &list, &count) != SPVC_SUCCESS) {
+			return {};
+		}
+		return { list, count };
+	};
+
+	constexpr std::array<std::pair<spvc_resource_type, DescriptorType>, 8> descriptorResourceTypes = {{
+		{ SPVC_RESOURCE_TYPE_UNIFORM_BUFFER, DescriptorType::UniformBuffer },
+		{ SPVC_RESOURCE_TYPE_STORAGE_BUFFER, DescriptorType::StorageBuffer },
+		{ SPVC_RESOURCE_TYPE_SAMPLED_IMAGE, DescriptorType::CombinedImageSampler },
+		{ SPVC_RESOURCE_TYPE_SEPARATE_IMAGE, DescriptorType::SampledImage },
+		{ SPVC_RESOURCE_TYPE_STORAGE_IMAGE, DescriptorType::StorageImage },
+		{ SPVC_RESOURCE_TYPE_SEPARATE_SAMPLERS, DescriptorType::Sampler },
+		{ SPVC_RESOURCE_TYPE_SUBPASS_INPUT, DescriptorType::InputAttachment },
+		{ SPVC_RESOURCE_TYPE_ACCELERATION_STRUCTURE, DescriptorType::AccelerationStructure },
+	}};
+
+	for (const auto& [resourceType, descriptorType] : descriptorResourceTypes) {
+		for (const auto& resource : getResources(resourceType)) {
+			auto type = spvc_compiler_get_type_handle(compiler, resource.type_id);
+			auto baseType = spvc_compiler_get_type_handle(compiler, resource.base_type_id);
+
+			// Images with a buffer dimension are texel buffers.
+			auto bindingType = descriptorType;
+			if (spvc_type_get_basetype(baseType) == SPVC_BASETYPE_IMAGE && spvc_type_get_image_dimension(baseType) == SpvDimBuffer) {
+				if (descriptorType == DescriptorType::SampledImage) {
+					bindingType = DescriptorType::UniformTexelBuffer;
+				} else if (descriptorType == DescriptorType::StorageImage) {
+					bindingType = DescriptorType::StorageTexelBuffer;
+				}
+			}
+
+			// A runtime sized array has a size of 0, which then also makes the count 0.
+			std::uint32_t count = 1;
+			for (auto i = 0U; i < spvc_type_get_num_array_dimensions(type); ++i) {
+				count *= spvc_type_get_array_dimension(type, i);
+			}
+
+			reflection.descriptorBindings.emplace_back(ReflectedDescriptorBinding {
+				.set = spvc_compiler_get_decoration(compiler, resource.id, SpvDecorationDescriptorSet),
+				.binding = spvc_compiler_get_decoration(compiler, resource.id, SpvDecorationBinding),
+				.type = bindingType,
+				.count = count,
+			});
+		}
+	}
+
+	for (const auto& resource : getResources(SPVC_RESOURCE_TYPE_PUSH_CONSTANT)) {
+		// We only want the range that is actually accessed by this entry point.
+		const spvc_buffer_range* ranges = nullptr;
+		size_t rangeCount = 0;
+		checkSpvcReturn(spvc_compiler_get_active_buffer_ranges(compiler, resource.id, &ranges, &rangeCount), "Failed to get buffer ranges");
+		if (rangeCount == 0) {
+			continue;
+		}
+
+		size_t begin = std::numeric_limits<size_t>::max();
+		size_t end = 0;
+		for (const auto& range : std::span(ranges, rangeCount)) {
+			begin = std::min(begin, range.offset);
+			end = std::max(end, range.offset + range.range);
+		}
+
+		reflection.pushConstantRanges.emplace_back(ReflectedPushConstantRange {
+			.offset = static_cast<std::uint32_t>(begin),
+			.size = static_cast<std::uint32_t>(end - begin),
+		});
+	}
+
+	if (entryPoint.stage == ShaderStage::Vertex) {
+		for (const auto& resource : getResources(SPVC_RESOURCE_TYPE_STAGE_INPUT)) {
+			auto type = spvc_compiler_get_type_handle(compiler, resource.type_id);
+			reflection.vertexInputs.emplace_back(ReflectedVertexInput {
+				.location = spvc_compiler_get_decoration(compiler, resource.id, SpvDecorationLocation),
+				.componentType = getComponentType(spvc_type_get_basetype(type)),
+				.componentCount = spvc_type_get_vector_size(type),
+			});
+		}
+	}
+
+	if (entryPoint.stage == ShaderStage::Compute || entryPoint.stage == ShaderStage::Mesh || entryPoint.stage == ShaderStage::Task) {
+		for (auto i = 0U; i < reflection.workgroupSize.size(); ++i) {
+			reflection.workgroupSize[i] = spvc_compiler_get_execution_mode_argument_by_index(compiler, SpvExecutionModeLocalSize, i);
+		}
+	}
+
+	// Sort everything so that the output does not depend on the order SPIRV-Cross finds the resources in.
+	std::sort(reflection.descriptorBindings.begin(), reflection.descriptorBindings.end(), [](const auto& a, const auto& b) {
+		return std::tie(a.set, a.binding) < std::tie(b.set, b.binding);
+	});
+	std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const auto& a, const auto& b) {
+		return a.location < b.location;
+	});
+
+	return reflection;
 }
@@ -0,0 +1,81 @@
+#include <bit>
+#include <cstring>
+
+#include <shaders/content_hash.hpp>
+
+namespace {
+	[[nodiscard]] constexpr std::uint64_t fmix64(std::uint64_t k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	[[nodiscard]] std::uint64_t loadLittleEndian(const std::byte* data) {
+		if constexpr (std::endian::native == std::endian::little) {
+			std::uint64_t value;
+			std::memcpy(&value, data, sizeof value);
+			return value;
+		} else {
+			std::uint64_t value = 0;
+			for (auto i = 0U; i < sizeof value; ++i) {
+				value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+			}
+			return value;
+		}
+	}
+} // namespace
+
+shaders::ContentHash shaders::hashContent(std::span<const std::byte> bytes) {
+	constexpr std::uint64_t c1 = 0x87c37b91114253d5ULL;
+	constexpr std::uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	std::uint64_t h1 = 0;
+	std::uint64_t h2 = 0;
+
+	const auto blockCount = bytes.size() / 16;
+	for (std::size_t i = 0; i < blockCount; ++i) {
+		auto k1 = loadLittleEndian(bytes.data() + i * 16);
+		auto k2 = loadLittleEndian(bytes.data() + i * 16 + 8);
+
+		h1 ^= std::rotl(k1 * c1, 31) * c2;
+		h1 = std::rotl(h1, 27) + h2;
+		h1 = h1 * 5 + 0x52dce729;
+
+		h2 ^= std::rotl(k2 * c2, 33) * c1;
+		h2 = std::rotl(h2, 31) + h1;
+		h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	// Process the remaining 0 to 15 bytes.
+	auto tail = bytes.subspan(blockCount * 16);
+	std::uint64_t k1 = 0;
+	std::uint64_t k2 = 0;
+	for (std::size_t i = 0; i < tail.size(); ++i) {
+		auto value = static_cast<std::uint64_t>(tail[i]);
+		if (i < 8) {
+			k1 |= value << (i * 8);
+		} else {
+			k2 |= value << ((i - 8) * 8);
+		}
+	}
+	if (tail.size() > 8) {
+		h2 ^= std::rotl(k2 * c2, 33) * c1;
+	}
+	if (!tail.empty()) {
+		h1 ^= std::rotl(k1 * c1, 31) * c2;
+	}
+
+	h1 ^= bytes.size();
+	h2 ^= bytes.size();
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	return { .low = h1, .high = h2 };
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef WITH_IO_URING
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <liburing.h>
+#endif
+
+#include <shaders/file_io.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	// Reads the file with a single read of its full size.
+	template <typename Container>
+	[[nodiscard]] std::optional<Container> readWholeFile(const fs::path& path) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			return std::nullopt;
+		}
+
+		Container contents(static_cast<std::size_t>(file.tellg()), {});
+		file.seekg(0, std::ios::beg);
+		file.read(reinterpret_cast<char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+		if (!file) {
+			return std::nullopt;
+		}
+		return contents;
+	}
+
+	void readFilesWithThreads(std::span<const fs::path> paths, std::vector<std::optional<std::vector<std::byte>>>& results) {
+		// The threads mostly wait for the disk, so using more than there are cores is fine.
+		constexpr std::size_t maxThreadCount = 16;
+
+		std::atomic<std::size_t> next = 0;
+		auto readPaths = [&]() {
+			for (auto i = next++; i < paths.size(); i = next++) {
+				results[i] = readWholeFile<std::vector<std::byte>>(paths[i]);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		auto usedThreads = std::min(paths.size(), maxThreadCount);
+		for (std::size_t i = 1; i < usedThreads; ++i) {
+			threads.emplace_back(readPaths);
+		}
+		readPaths();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+#ifdef WITH_IO_URING
+	constexpr unsigned ringEntries = 64;
+
+	// Submits all queued requests and calls onCompletion with the user data and result of each of the count requests.
+	// The requests point into buffers of the caller, so even if submitting fails partway, this only returns once
+	// every request that reached the kernel has completed. Returns false if not all requests could be submitted.
+	template <typename Function>
+	[[nodiscard]] bool completeRequests(io_uring& ring, std::size_t count, Function&& onCompletion) {
+		std::size_t submitted = 0;
+		while (submitted < count) {
+			auto result = io_uring_submit(&ring);
+			if (result == -EINTR) {
+				continue;
+			}
+			if (result <= 0) {
+				break;
+			}
+			submitted += static_cast<std::size_t>(result);
+		}
+
+		std::size_t completed = 0;
+		while (completed < submitted) {
+			io_uring_cqe* cqe = nullptr;
+			auto result = io_uring_wait_cqe(&ring, &cqe);
+			if (result == -EINTR || result == -EAGAIN) {
+				continue;
+			}
+			if (result < 0) {
+				// Returning now would let the kernel write into memory that is about to be freed.
+				std::cerr << "Failed to wait for io_uring completions: " << std::strerror(-result) << std::endl;
+				std::abort();
+			}
+			onCompletion(reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(cqe)), cqe->res);
+			io_uring_cqe_seen(&ring, cqe);
+			++completed;
+		}
+		return submitted == count;
+	}
+
+	[[nodiscard]] bool readBatchWithIoUring(io_uring& ring, std::span<const fs::path> paths,
+	                                        std::span<std::optional<std::vector<std::byte>>> results) {
+		std::vector<std::string> pathStrings(paths.begin(), paths.end());
+		std::vector<int> fds(paths.size(), -1);
+		std::vector<struct statx> stats(paths.size());
+
+		// Opening and querying the size do not depend on each other, so both are submitted at once.
+		for (std::size_t i = 0; i < paths.size(); ++i) {
+			auto* open = io_uring_get_sqe(&ring);
+			io_uring_prep_openat(open, AT_FDCWD, pathStrings[i].c_str(), O_RDONLY | O_CLOEXEC, 0);
+			io_uring_sqe_set_data(open, reinterpret_cast<void*>(static_cast<std::uintptr_t>(i * 2)));
+
+			auto* stat = io_uring_get_sqe(&ring);
+			io_uring_prep_statx(stat, AT_FDCWD, pathStrings[i].c_str(), 0, STATX_SIZE, &stats[i]);
+			io_uring_sqe_set_data(stat, reinterpret_cast<void*>(static_cast<std::uintptr_t>(i * 2 + 1)));
+		}
+
+		std::vector<bool> statted(paths.size(), false);
+		auto opened = completeRequests(ring, paths.size() * 2, [&](std::uintptr_t data, std::int32_t result) {
+			if (data % 2 == 0) {
+				fds[data / 2] = result;
+			} else {
+				statted[data / 2] = result == 0;
+			}
+		});
+
+		// Short reads are resubmitted for the remaining bytes until the file is complete.
+		std::vector<std::size_t> offsets(paths.size(), 0);
+		std::vector<std::size_t> pendingReads;
+		if (opened) {
+			for (std::size_t i = 0; i < paths.size(); ++i) {
+				if (fds[i] >= 0 && statted[i]) {
+					results[i].emplace(stats[i].stx_size);
+					pendingReads.emplace_back(i);
+				}
+			}
+		}
+
+		bool success = opened;
+		while (success && !pendingReads.empty()) {
+			for (auto i : pendingReads) {
+				auto& bytes = *results[i];
+				auto* read = io_uring_get_sqe(&ring);
+				io_uring_prep_read(read, fds[i], bytes.data() + offsets[i], static_cast<unsigned>(bytes.size() - offsets[i]), offsets[i]);
+				io_uring_sqe_set_data(read, reinterpret_cast<void*>(static_cast<std::uintptr_t>(i)));
+			}
+
+			std::vector<std::size_t> incompleteReads;
+			success = completeRequests(ring, pendingReads.size(), [&](std::uintptr_t i, std::int32_t result) {
+				if (result < 0) {
+					results[i].reset();
+				} else if (result == 0) {
+					// The file shrunk since querying its size.
+					results[i]->resize(offsets[i]);
+				} else {
+					offsets[i] += static_cast<std::size_t>(result);
+					if (offsets[i] < results[i]->size()) {
+						incompleteReads.emplace_back(i);
+					}
+				}
+			});
+			pendingReads = std::move(incompleteReads);
+		}
+
+		for (auto fd : fds) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+		return success;
+	}
+
+	[[nodiscard]] bool readFilesWithIoUring(std::span<const fs::path> paths, std::vector<std::optional<std::vector<std::byte>>>& results) {
+		io_uring ring;
+		if (io_uring_queue_init(ringEntries, &ring, 0) < 0) {
+			// io_uring might be disabled, for example inside of containers.
+			return false;
+		}
+
+		// Every file takes two entries while opening, so the batches are half the size of the ring.
+		constexpr std::size_t batchSize = ringEntries / 2;
+		bool success = true;
+		for (std::size_t begin = 0; success && begin < paths.size(); begin += batchSize) {
+			auto count = std::min(batchSize, paths.size() - begin);
+			success = readBatchWithIoUring(ring, paths.subspan(begin, count), std::span(results).subspan(begin, count));
+		}
+		io_uring_queue_exit(&ring);
+		return success;
+	}
+#endif
+
+	// Every process picks a random prefix and counts up from there, so that concurrent writers to the same
+	// destination, also from different processes, never write into the same temporary file.
+	fs::path getTemporaryPath(const fs::path& path) {
+		static const auto processKey = (static_cast<std::uint64_t>(std::random_device {}()) << 32) | std::random_device {}();
+		static std::atomic<std::uint32_t> counter = 0;
+		std::ostringstream suffix;
+		suffix << '.' << std::hex << processKey << '.' << counter.fetch_add(1, std::memory_order_relaxed) << ".tmp";
+		auto temporaryPath = path;
+		temporaryPath += suffix.str();
+		return temporaryPath;
+	}
+} // namespace
+
+std::string shaders::readFileAsString(const fs::path& path) {
+	return readWholeFile<std::string>(path).value_or(std::string {});
+}
+
+std::vector<std::byte> shaders::readFileAsBytes(const fs::path& path) {
+	return readWholeFile<std::vector<std::byte>>(path).value_or(std::vector<std::byte> {});
+}
+
+std::vector<std::optional<std::vector<std::byte>>> shaders::readFiles(std::span<const fs::path> paths) {
+	std::vector<std::optional<std::vector<std::byte>>> results(paths.size());
+
+#ifdef WITH_IO_URING
+	if (readFilesWithIoUring(paths, results)) {
+		return results;
+	}
+	std::fill(results.begin(), results.end(), std::nullopt);
+#endif
+
+	readFilesWithThreads(paths, results);
+	return results;
+}
+
+shaders::AsyncFileWriter::~AsyncFileWriter() {
+	(void)wait();
+}
+
+void shaders::AsyncFileWriter::write(fs::path path, std::vector<std::byte> bytes) {
+	pendingWrites.emplace_back(std::async(std::launch::async, [path = std::move(path), bytes = std::move(bytes)]() {
+		// The file is written next to the destination and then renamed over it, so that a program
+		// reloading the file never sees it partially written.
+		auto temporaryPath = getTemporaryPath(path);
+		{
+			std::ofstream out(temporaryPath, std::ios::binary | std::ios::out | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!out) {
+				std::cerr << "Failed to write " << path << std::endl;
+				return false;
+			}
+		}
+
+		std::error_code error;
+		fs::rename(temporaryPath, path, error);
+		if (error) {
+			std::cerr << "Failed to write " << path << ": " << error.message() << std::endl;
+			fs::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}));
+}
+
+bool shaders::AsyncFileWriter::wait() {
+	bool success = true;
+	for (auto& write : pendingWrites) {
+		success &= write.get();
+	}
+	pendingWrites.clear();
+	return success;
+}
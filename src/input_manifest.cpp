@@ -0,0 +1,194 @@
+#include <fstream>
+#include <sstream>
+
+#ifdef WITH_FILE_INODES
+#include <sys/stat.h>
+#endif
+
+#include <shaders/file_io.hpp>
+#include <shaders/input_manifest.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	// Every line is a kind, followed by the values for it. Paths are last, so that they can contain spaces.
+	//   options <options>
+	//   input <size> <modified time> <inode> <hash low> <hash high> <path>
+	//   output <size> <modified time> <inode> <path>
+	void writeStat(std::ostream& out, const shaders::FileStat& stat) {
+		out << stat.size << ' ' << stat.modifiedTime << ' ' << stat.inode << ' ';
+	}
+
+	[[nodiscard]] bool readStat(std::istream& in, shaders::FileStat& stat) {
+		return static_cast<bool>(in >> stat.size >> stat.modifiedTime >> stat.inode);
+	}
+
+	[[nodiscard]] bool readPath(std::istream& in, fs::path& path) {
+		std::string pathString;
+		if (in.get() != ' ' || !std::getline(in, pathString)) {
+			return false;
+		}
+		path = pathString;
+		return true;
+	}
+} // namespace
+
+std::optional<shaders::FileStat> shaders::getFileStat(const fs::path& path) {
+#ifdef WITH_FILE_INODES
+	// A single stat call, as this runs for every input of every library on every build.
+	struct stat result = {};
+	if (::stat(path.c_str(), &result) != 0) {
+		return std::nullopt;
+	}
+#ifdef __APPLE__
+	const auto& modifiedTime = result.st_mtimespec;
+#else
+	const auto& modifiedTime = result.st_mtim;
+#endif
+	return FileStat {
+		.size = static_cast<std::uint64_t>(result.st_size),
+		.modifiedTime = static_cast<std::int64_t>(modifiedTime.tv_sec) * 1000000000 + modifiedTime.tv_nsec,
+		.inode = static_cast<std::uint64_t>(result.st_ino),
+	};
+#else
+	std::error_code error;
+	auto size = fs::file_size(path, error);
+	if (error) {
+		return std::nullopt;
+	}
+	auto modifiedTime = fs::last_write_time(path, error);
+	if (error) {
+		return std::nullopt;
+	}
+	return FileStat {
+		.size = size,
+		.modifiedTime = static_cast<std::int64_t>(modifiedTime.time_since_epoch().count()),
+		.inode = 0,
+	};
+#endif
+}
+
+std::optional<std::vector<shaders::FileRecord>> shaders::recordInputFiles(std::span<const fs::path> paths, const InputManifest* previous) {
+	std::vector<FileRecord> records;
+	records.reserve(paths.size());
+	for (const auto& path : paths) {
+		auto stat = getFileStat(path);
+		if (!stat.has_value()) {
+			return std::nullopt;
+		}
+
+		auto& record = records.emplace_back(FileRecord { .path = path, .stat = *stat, .hash = {} });
+		const FileRecord* previousRecord = nullptr;
+		if (previous != nullptr) {
+			for (const auto& input : previous->inputs) {
+				if (input.path == path) {
+					previousRecord = &input;
+					break;
+				}
+			}
+		}
+
+		if (previousRecord != nullptr && previousRecord->stat == *stat) {
+			record.hash = previousRecord->hash;
+		} else {
+			record.hash = hashContent(readFileAsBytes(path));
+		}
+	}
+	return records;
+}
+
+std::optional<std::vector<shaders::FileRecord>> shaders::recordOutputFiles(std::span<const fs::path> paths) {
+	std::vector<FileRecord> records;
+	records.reserve(paths.size());
+	for (const auto& path : paths) {
+		auto stat = getFileStat(path);
+		if (!stat.has_value()) {
+			return std::nullopt;
+		}
+		records.emplace_back(FileRecord { .path = path, .stat = *stat, .hash = {} });
+	}
+	return records;
+}
+
+std::optional<shaders::InputManifest> shaders::readInputManifest(const fs::path& path) {
+	std::ifstream file(path);
+	if (!file) {
+		return std::nullopt;
+	}
+
+	InputManifest manifest;
+	std::string kind;
+	while (file >> kind) {
+		if (kind == "options") {
+			if (file.get() != ' ' || !std::getline(file, manifest.options)) {
+				return std::nullopt;
+			}
+		} else if (kind == "input") {
+			auto& record = manifest.inputs.emplace_back();
+			if (!readStat(file, record.stat) || !(file >> std::hex >> record.hash.low >> record.hash.high >> std::dec)
+			    || !readPath(file, record.path)) {
+				return std::nullopt;
+			}
+		} else if (kind == "output") {
+			auto& record = manifest.outputs.emplace_back();
+			if (!readStat(file, record.stat) || !readPath(file, record.path)) {
+				return std::nullopt;
+			}
+		} else {
+			return std::nullopt;
+		}
+	}
+	return manifest;
+}
+
+bool shaders::writeInputManifest(const fs::path& path, const InputManifest& manifest) {
+	std::ostringstream out;
+	out << "options " << manifest.options << '\n';
+	for (const auto& input : manifest.inputs) {
+		out << "input ";
+		writeStat(out, input.stat);
+		out << std::hex << input.hash.low << ' ' << input.hash.high << std::dec << ' ' << input.path.string() << '\n';
+	}
+	for (const auto& output : manifest.outputs) {
+		out << "output ";
+		writeStat(out, output.stat);
+		out << output.path.string() << '\n';
+	}
+
+	auto contents = out.str();
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	return static_cast<bool>(file);
+}
+
+bool shaders::isInputManifestCurrent(InputManifest& manifest, std::string_view options, bool& updated) {
+	updated = false;
+	if (manifest.options != options) {
+		return false;
+	}
+
+	for (const auto& output : manifest.outputs) {
+		auto stat = getFileStat(output.path);
+		if (!stat.has_value() || *stat != output.stat) {
+			return false;
+		}
+	}
+
+	for (auto& input : manifest.inputs) {
+		auto stat = getFileStat(input.path);
+		if (!stat.has_value()) {
+			return false;
+		}
+		if (*stat == input.stat) {
+			continue;
+		}
+
+		// Saving a file without changes or checking it out again changes its stat data, but not its contents.
+		if (hashContent(readFileAsBytes(input.path)) != input.hash) {
+			return false;
+		}
+		input.stat = *stat;
+		updated = true;
+	}
+	return true;
+}
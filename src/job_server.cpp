@@ -0,0 +1,149 @@
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef WITH_JOBSERVER
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include <shaders/job_server.hpp>
+
+#ifdef WITH_JOBSERVER
+namespace {
+	// How long to wait for a token before checking whether it is still needed.
+	constexpr int pollTimeoutMilliseconds = 100;
+
+	[[nodiscard]] bool parseFd(std::string_view value, int& fd) {
+		auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), fd);
+		return error == std::errc {} && ptr == value.data() + value.size() && fd >= 0 && ::fcntl(fd, F_GETFD) != -1;
+	}
+
+	// Returns the value of the last jobserver option, as recursive makes append theirs.
+	[[nodiscard]] std::string_view getJobServerAuth(std::string_view makeFlags) {
+		std::string_view auth;
+		for (std::string_view option : { "--jobserver-auth=", "--jobserver-fds=" }) {
+			auto pos = makeFlags.rfind(option);
+			if (pos == std::string_view::npos) {
+				continue;
+			}
+			auto value = makeFlags.substr(pos + option.size());
+			auth = value.substr(0, value.find(' '));
+			break;
+		}
+		return auth;
+	}
+} // namespace
+#endif
+
+shaders::JobServerClient::JobServerClient(int readFd, int writeFd, bool ownsReadFd, bool ownsWriteFd)
+	: readFd(readFd), writeFd(writeFd), ownsReadFd(ownsReadFd), ownsWriteFd(ownsWriteFd) {}
+
+shaders::JobServerClient::JobServerClient(JobServerClient&& other) noexcept
+	: readFd(std::exchange(other.readFd, -1)), writeFd(std::exchange(other.writeFd, -1)),
+	  ownsReadFd(std::exchange(other.ownsReadFd, false)), ownsWriteFd(std::exchange(other.ownsWriteFd, false)) {}
+
+shaders::JobServerClient& shaders::JobServerClient::operator=(JobServerClient&& other) noexcept {
+	std::swap(readFd, other.readFd);
+	std::swap(writeFd, other.writeFd);
+	std::swap(ownsReadFd, other.ownsReadFd);
+	std::swap(ownsWriteFd, other.ownsWriteFd);
+	return *this;
+}
+
+shaders::JobServerClient::~JobServerClient() {
+#ifdef WITH_JOBSERVER
+	if (ownsReadFd) {
+		::close(readFd);
+	}
+	if (ownsWriteFd && writeFd != readFd) {
+		::close(writeFd);
+	}
+#endif
+}
+
+std::optional<shaders::JobServerClient> shaders::JobServerClient::fromEnvironment() {
+#ifdef WITH_JOBSERVER
+	const auto* makeFlags = std::getenv("MAKEFLAGS");
+	if (makeFlags == nullptr) {
+		return std::nullopt;
+	}
+
+	auto auth = getJobServerAuth(makeFlags);
+	if (auth.empty()) {
+		return std::nullopt;
+	}
+
+	if (auth.starts_with("fifo:")) {
+		std::string path { auth.substr(5) };
+		auto fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0) {
+			std::cerr << "Failed to open jobserver fifo: " << path << std::endl;
+			return std::nullopt;
+		}
+		return JobServerClient(fd, fd, true, true);
+	}
+
+	// Make only passes the pipe to commands it knows to be jobserver aware, and closes it for all others.
+	auto separator = auth.find(',');
+	int readFd = -1;
+	int writeFd = -1;
+	if (separator == std::string_view::npos || !parseFd(auth.substr(0, separator), readFd) || !parseFd(auth.substr(separator + 1), writeFd)) {
+		return std::nullopt;
+	}
+
+	// The inherited pipe is shared with make, so it cannot be made non-blocking. Reopening it creates a separate
+	// description that can, which avoids blocking when another process takes the token after polling.
+	auto ownReadFd = ::open(("/proc/self/fd/" + std::to_string(readFd)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (ownReadFd >= 0) {
+		return JobServerClient(ownReadFd, writeFd, true, false);
+	}
+	return JobServerClient(readFd, writeFd, false, false);
+#else
+	return std::nullopt;
+#endif
+}
+
+std::optional<std::byte> shaders::JobServerClient::acquire(const std::function<bool()>& stillNeeded) const {
+#ifdef WITH_JOBSERVER
+	while (stillNeeded()) {
+		pollfd fd = { .fd = readFd, .events = POLLIN, .revents = 0 };
+		auto ready = ::poll(&fd, 1, pollTimeoutMilliseconds);
+		if (ready < 0 && errno != EINTR) {
+			return std::nullopt;
+		}
+		if (ready <= 0) {
+			continue;
+		}
+
+		std::byte token = {};
+		auto result = ::read(readFd, &token, 1);
+		if (result == 1) {
+			return token;
+		}
+		// Another process might have taken the token between polling and reading.
+		if (result < 0 && (errno == EAGAIN || errno == EINTR)) {
+			continue;
+		}
+		return std::nullopt;
+	}
+#else
+	(void)stillNeeded;
+#endif
+	return std::nullopt;
+}
+
+void shaders::JobServerClient::release(std::byte token) const {
+#ifdef WITH_JOBSERVER
+	while (::write(writeFd, &token, 1) < 0 && errno == EINTR) {
+	}
+#else
+	(void)token;
+#endif
+}
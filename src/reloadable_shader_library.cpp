@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <system_error>
+
+#include <shaders/reloadable_shader_library.hpp>
+
+namespace fs = std::filesystem;
+
+shaders::ReloadableShaderLibrary::ReloadableShaderLibrary(fs::path path, ShaderLibraryReadFlags flags)
+	: path(std::move(path)), flags(flags) {
+	(void)reload();
+}
+
+const shaders::ShaderLibrary& shaders::ReloadableShaderLibrary::getLibrary() const {
+	return library;
+}
+
+const fs::path& shaders::ReloadableShaderLibrary::getPath() const {
+	return path;
+}
+
+shaders::ShaderLibraryChanges shaders::ReloadableShaderLibrary::poll() {
+	std::error_code error;
+	auto writeTime = fs::last_write_time(path, error);
+	if (error || writeTime == lastWriteTime) {
+		return {};
+	}
+	return reload();
+}
+
+shaders::ShaderLibraryChanges shaders::ReloadableShaderLibrary::reload() {
+	std::error_code error;
+	auto writeTime = fs::last_write_time(path, error);
+	if (error) {
+		return {};
+	}
+
+	auto newLibrary = readShaderLibraryFromFile(path, flags);
+	if (newLibrary.getShaderBinaries().empty()) {
+		// The modification time is not updated, so that the next poll tries again.
+		return {};
+	}
+
+	ShaderLibraryChanges changes = {};
+	changes.reloaded = true;
+	auto oldBinaries = library.getShaderBinaries();
+	std::vector<bool> matched(oldBinaries.size(), false);
+	for (const auto& binary : newLibrary.getShaderBinaries()) {
+		auto it = std::find_if(oldBinaries.begin(), oldBinaries.end(), [&binary](const ShaderBinary& oldBinary) {
+			return oldBinary.shaderName == binary.shaderName && oldBinary.name == binary.name && oldBinary.lang == binary.lang
+			       && oldBinary.spirvVersion == binary.spirvVersion;
+		});
+
+		if (it == oldBinaries.end()) {
+			changes.changedBinaries.emplace_back(&binary);
+			continue;
+		}
+
+		matched[static_cast<std::size_t>(it - oldBinaries.begin())] = true;
+		if (it->hash != binary.hash || it->stage != binary.stage) {
+			changes.changedBinaries.emplace_back(&binary);
+		}
+	}
+
+	for (std::size_t i = 0; i < oldBinaries.size(); ++i) {
+		if (!matched[i]) {
+			changes.removedBinaries.emplace_back(RemovedShaderBinary {
+				.shaderName = std::string { oldBinaries[i].shaderName },
+				.name = std::string { oldBinaries[i].name },
+				.lang = oldBinaries[i].lang,
+				.spirvVersion = oldBinaries[i].spirvVersion,
+			});
+		}
+	}
+
+	// The binaries of the new library point into its storage, which stays in place when moving the library.
+	library = std::move(newLibrary);
+	lastWriteTime = writeTime;
+	return changes;
+}
@@ -0,0 +1,612 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <shaders/remote_compile.hpp>
+
+namespace {
+	// Sanity limit for a single message, so that a corrupt size does not exhaust all memory.
+	constexpr std::uint32_t maxMessageSize = 1U << 30;
+
+	// Results up to this size are returned through the memory shared with a worker process. Only the pages that are
+	// actually written take up memory.
+	constexpr std::size_t sharedResultSize = 16U << 20;
+
+	struct WorkerProcess {
+		pid_t pid;
+		int fd;
+		std::span<std::byte> sharedResult;
+	};
+
+	class MessageWriter {
+		std::vector<std::byte> bytes;
+
+	public:
+		void write(const void* data, std::size_t size) {
+			const auto* begin = static_cast<const std::byte*>(data);
+			bytes.insert(bytes.end(), begin, begin + size);
+		}
+
+		template <typename T>
+		void write(T value) {
+			write(&value, sizeof value);
+		}
+
+		void writeString(std::string_view string) {
+			write(static_cast<std::uint32_t>(string.size()));
+			write(string.data(), string.size());
+		}
+
+		[[nodiscard]] std::vector<std::byte> take() {
+			return std::move(bytes);
+		}
+	};
+
+	class MessageReader {
+		std::span<const std::byte> bytes;
+
+	public:
+		explicit MessageReader(std::span<const std::byte> bytes) : bytes(bytes) {}
+
+		[[nodiscard]] bool read(void* data, std::size_t size) {
+			if (bytes.size() < size) {
+				return false;
+			}
+			std::memcpy(data, bytes.data(), size);
+			bytes = bytes.subspan(size);
+			return true;
+		}
+
+		template <typename T>
+		[[nodiscard]] bool read(T& value) {
+			return read(&value, sizeof value);
+		}
+
+		[[nodiscard]] bool readString(std::string& string) {
+			std::uint32_t size = 0;
+			if (!read(size) || bytes.size() < size) {
+				return false;
+			}
+			string.assign(reinterpret_cast<const char*>(bytes.data()), size);
+			bytes = bytes.subspan(size);
+			return true;
+		}
+	};
+
+	bool writeAll(int fd, const std::byte* data, std::size_t size) {
+		while (size > 0) {
+			auto written = ::write(fd, data, size);
+			if (written < 0 && errno == EINTR) {
+				continue;
+			}
+			if (written <= 0) {
+				return false;
+			}
+			data += written;
+			size -= static_cast<std::size_t>(written);
+		}
+		return true;
+	}
+
+	bool readAll(int fd, std::byte* data, std::size_t size) {
+		while (size > 0) {
+			auto count = ::read(fd, data, size);
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count <= 0) {
+				return false;
+			}
+			data += count;
+			size -= static_cast<std::size_t>(count);
+		}
+		return true;
+	}
+
+	// Creates a socket for the given address, and either connects it or binds and listens on it.
+	int openSocket(std::string_view address, bool listen) {
+		constexpr std::string_view unixPrefix = "unix:";
+		if (address.starts_with(unixPrefix)) {
+			auto path = address.substr(unixPrefix.size());
+			sockaddr_un socketAddress = {};
+			socketAddress.sun_family = AF_UNIX;
+			if (path.empty() || path.size() >= sizeof(socketAddress.sun_path)) {
+				std::cerr << "Invalid Unix socket path: " << path << std::endl;
+				return -1;
+			}
+			std::memcpy(socketAddress.sun_path, path.data(), path.size());
+
+			auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (fd < 0) {
+				return -1;
+			}
+
+			const auto* genericAddress = reinterpret_cast<const sockaddr*>(&socketAddress);
+			if (listen) {
+				// Remove a socket file left over by a previous worker.
+				::unlink(socketAddress.sun_path);
+				if (::bind(fd, genericAddress, sizeof socketAddress) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+					return fd;
+				}
+			} else if (::connect(fd, genericAddress, sizeof socketAddress) == 0) {
+				return fd;
+			}
+			::close(fd);
+			return -1;
+		}
+
+		auto separator = address.rfind(':');
+		if (separator == std::string_view::npos) {
+			std::cerr << "Invalid worker address, expected <host>:<port> or unix:<path>: " << address << std::endl;
+			return -1;
+		}
+		auto host = std::string { address.substr(0, separator) };
+		auto port = std::string { address.substr(separator + 1) };
+
+		// Workers execute whatever they are sent, so without a host they only listen on the loopback interface.
+		// Listening on all interfaces has to be asked for with "*".
+		auto allInterfaces = host == "*";
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = listen && allInterfaces ? AI_PASSIVE : 0;
+
+		addrinfo* addresses = nullptr;
+		if (auto error = ::getaddrinfo(host.empty() || allInterfaces ? nullptr : host.c_str(), port.c_str(), &hints, &addresses); error != 0) {
+			std::cerr << "Failed to resolve " << address << ": " << ::gai_strerror(error) << std::endl;
+			return -1;
+		}
+
+		int fd = -1;
+		for (auto* info = addresses; info != nullptr; info = info->ai_next) {
+			fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+			if (fd < 0) {
+				continue;
+			}
+
+			// The messages are small and strictly request/response, so don't wait for more data.
+			int enable = 1;
+			::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof enable);
+			if (listen) {
+				::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof enable);
+				if (::bind(fd, info->ai_addr, info->ai_addrlen) == 0 && ::listen(fd, SOMAXCONN) == 0) {
+					break;
+				}
+			} else if (::connect(fd, info->ai_addr, info->ai_addrlen) == 0) {
+				break;
+			}
+			::close(fd);
+			fd = -1;
+		}
+		::freeaddrinfo(addresses);
+		return fd;
+	}
+
+	// Writes the result in the format of serializeCompileJobResult. Returns false if it does not fit.
+	bool writeSharedResult(const shaders::CompileJobResult& result, std::span<std::byte> sharedResult) {
+		std::size_t size = sizeof(std::uint32_t);
+		for (const auto& spirv : result) {
+			size += sizeof(std::uint32_t) + spirv.size() * sizeof(std::uint32_t);
+		}
+		if (size > sharedResult.size()) {
+			return false;
+		}
+
+		auto* out = sharedResult.data();
+		auto write = [&out](const void* data, std::size_t byteSize) {
+			std::memcpy(out, data, byteSize);
+			out += byteSize;
+		};
+		auto moduleCount = static_cast<std::uint32_t>(result.size());
+		write(&moduleCount, sizeof moduleCount);
+		for (const auto& spirv : result) {
+			auto wordCount = static_cast<std::uint32_t>(spirv.size());
+			write(&wordCount, sizeof wordCount);
+			write(spirv.data(), spirv.size() * sizeof(std::uint32_t));
+		}
+		return true;
+	}
+
+	// Executes a job received from a coordinator. Errors, including exceptions thrown by the compilers, fail only
+	// this job by returning an empty result, as an exception escaping a connection thread would end the worker.
+	shaders::CompileJobResult executeReceivedJob(std::span<const std::byte> message, bool log) {
+		try {
+			auto job = shaders::deserializeCompileJob(message);
+			if (!job.has_value()) {
+				std::cerr << "Received malformed compile job." << std::endl;
+				return {};
+			}
+			if (log) {
+				std::cout << ">> " << job->sourcePath << std::endl;
+			}
+			return shaders::executeCompileJob(*job);
+		} catch (const std::exception& exception) {
+			std::cerr << "Failed to execute compile job: " << exception.what() << std::endl;
+			return {};
+		}
+	}
+
+	// The body of a forked worker process, which runs until the socket is closed. Results are written to the shared
+	// memory, and the message only signals that they are ready by being empty, so that the SPIR-V does not have to go
+	// through the socket. Larger results are sent in the message instead.
+	[[noreturn]] void runWorkerProcess(int fd, std::span<std::byte> sharedResult) {
+		while (auto message = shaders::receiveMessage(fd, shaders::compileJobMagic)) {
+			auto result = executeReceivedJob(*message, false);
+			std::vector<std::byte> payload;
+			if (!writeSharedResult(result, sharedResult)) {
+				payload = shaders::serializeCompileJobResult(result);
+			}
+			if (!shaders::sendMessage(fd, shaders::compileResultMagic, payload)) {
+				break;
+			}
+		}
+		// Exiting normally would run the destructors of everything inherited from the parent.
+		::_exit(0);
+	}
+
+	void serveConnection(int fd) {
+		while (true) {
+			auto message = shaders::receiveMessage(fd, shaders::compileJobMagic);
+			if (!message.has_value()) {
+				break;
+			}
+
+			auto result = executeReceivedJob(*message, true);
+			if (!shaders::sendMessage(fd, shaders::compileResultMagic, shaders::serializeCompileJobResult(result))) {
+				break;
+			}
+		}
+		::close(fd);
+	}
+} // namespace
+
+std::vector<std::byte> shaders::serializeCompileJob(const CompileJob& job) {
+	MessageWriter writer;
+	writer.write(job.lang);
+	writer.writeString(job.sourcePath);
+	writer.writeString(job.source);
+	writer.write(static_cast<std::uint32_t>(job.entryPoints.size()));
+	for (const auto& entryPoint : job.entryPoints) {
+		writer.write(entryPoint.stage);
+		writer.writeString(entryPoint.name);
+	}
+	writer.write(static_cast<std::uint32_t>(job.spirvVersions.size()));
+	for (auto version : job.spirvVersions) {
+		writer.write(version);
+	}
+	return writer.take();
+}
+
+std::optional<shaders::CompileJob> shaders::deserializeCompileJob(std::span<const std::byte> bytes) {
+	MessageReader reader(bytes);
+	CompileJob job = {};
+	std::uint32_t entryPointCount = 0;
+	if (!reader.read(job.lang) || !reader.readString(job.sourcePath) || !reader.readString(job.source) || !reader.read(entryPointCount)) {
+		return std::nullopt;
+	}
+
+	// The enums are used to index into tables and select compilers, so only accept values this build knows.
+	// GLSL is always compiled with a single entry point.
+	if (!canCompileToSpirv(job.lang) || entryPointCount == 0 || (job.lang == ShaderLang::GLSL && entryPointCount != 1)) {
+		return std::nullopt;
+	}
+
+	for (auto i = 0U; i < entryPointCount; ++i) {
+		ShaderEntryPoint entryPoint = {};
+		if (!reader.read(entryPoint.stage) || !reader.readString(entryPoint.name)) {
+			return std::nullopt;
+		}
+		auto stage = static_cast<std::uint16_t>(entryPoint.stage);
+		if (stage == 0 || (stage & (stage - 1)) != 0 || stage > static_cast<std::uint16_t>(ShaderStage::Callable)) {
+			return std::nullopt;
+		}
+		job.entryPoints.emplace_back(std::move(entryPoint));
+	}
+
+	std::uint32_t versionCount = 0;
+	if (!reader.read(versionCount) || versionCount == 0) {
+		return std::nullopt;
+	}
+	for (auto i = 0U; i < versionCount; ++i) {
+		SPVVersion version = {};
+		if (!reader.read(version) || version > SPVVersion::SPV_1_6) {
+			return std::nullopt;
+		}
+		job.spirvVersions.emplace_back(version);
+	}
+	return job;
+}
+
+std::vector<std::byte> shaders::serializeCompileJobResult(const CompileJobResult& result) {
+	MessageWriter writer;
+	writer.write(static_cast<std::uint32_t>(result.size()));
+	for (const auto& spirv : result) {
+		writer.write(static_cast<std::uint32_t>(spirv.size()));
+		writer.write(spirv.data(), spirv.size() * sizeof(std::uint32_t));
+	}
+	return writer.take();
+}
+
+std::optional<shaders::CompileJobResult> shaders::deserializeCompileJobResult(std::span<const std::byte> bytes) {
+	MessageReader reader(bytes);
+	std::uint32_t moduleCount = 0;
+	if (!reader.read(moduleCount)) {
+		return std::nullopt;
+	}
+
+	CompileJobResult result;
+	for (auto i = 0U; i < moduleCount; ++i) {
+		std::uint32_t wordCount = 0;
+		if (!reader.read(wordCount) || wordCount > maxMessageSize / sizeof(std::uint32_t)) {
+			return std::nullopt;
+		}
+
+		std::vector<std::uint32_t> spirv(wordCount);
+		if (!reader.read(spirv.data(), spirv.size() * sizeof(std::uint32_t))) {
+			return std::nullopt;
+		}
+		result.emplace_back(std::move(spirv));
+	}
+	return result;
+}
+
+bool shaders::sendMessage(int fd, std::uint32_t magic, std::span<const std::byte> payload) {
+	if (payload.size() > maxMessageSize) {
+		return false;
+	}
+
+	std::array<std::uint32_t, 2> header = { magic, static_cast<std::uint32_t>(payload.size()) };
+	return writeAll(fd, reinterpret_cast<const std::byte*>(header.data()), sizeof header)
+	       && writeAll(fd, payload.data(), payload.size());
+}
+
+std::optional<std::vector<std::byte>> shaders::receiveMessage(int fd, std::uint32_t magic) {
+	std::array<std::uint32_t, 2> header = {};
+	if (!readAll(fd, reinterpret_cast<std::byte*>(header.data()), sizeof header)) {
+		return std::nullopt;
+	}
+
+	// The values are not swapped, so a byte-swapped magic means the other side runs on a machine of different endianness.
+	auto swappedMagic = ((magic & 0xFFU) << 24) | ((magic & 0xFF00U) << 8) | ((magic >> 8) & 0xFF00U) | (magic >> 24);
+	if (header[0] == swappedMagic) {
+		std::cerr << "Received message in a different byte order. Workers need to have the same endianness as the coordinator." << std::endl;
+		return std::nullopt;
+	}
+
+	if (header[0] != magic || header[1] > maxMessageSize) {
+		std::cerr << "Received invalid message header." << std::endl;
+		return std::nullopt;
+	}
+
+	std::vector<std::byte> payload(header[1]);
+	if (!readAll(fd, payload.data(), payload.size())) {
+		return std::nullopt;
+	}
+	return payload;
+}
+
+std::int32_t shaders::runCompileWorker(std::string_view address) {
+	// A coordinator going away while we write should not kill the worker.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	auto listenFd = openSocket(address, true);
+	if (listenFd < 0) {
+		std::cerr << "Failed to listen on " << address << ": " << std::strerror(errno) << std::endl;
+		return -1;
+	}
+
+	std::cout << "Listening for compile jobs on " << address << std::endl;
+	while (true) {
+		auto fd = ::accept(listenFd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			std::cerr << "Failed to accept connection: " << std::strerror(errno) << std::endl;
+			::close(listenFd);
+			return -1;
+		}
+
+		// Every coordinator gets its own thread, as it sends the next job only after receiving a result.
+		std::thread(serveConnection, fd).detach();
+	}
+}
+
+std::vector<std::optional<shaders::CompileJobResult>> shaders::executeRemoteCompileJobs(std::span<const std::string> workerAddresses,
+                                                                                       std::span<const CompileJob> jobs,
+                                                                                       std::span<const std::size_t> order) {
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::vector<std::optional<CompileJobResult>> results(jobs.size());
+
+	std::mutex pendingMutex;
+	std::deque<std::size_t> pendingJobs(order.begin(), order.end());
+
+	auto runWorker = [&](const std::string& address) {
+		auto fd = openSocket(address, false);
+		if (fd < 0) {
+			std::cerr << "Failed to connect to worker " << address << std::endl;
+			return;
+		}
+
+		while (true) {
+			std::size_t jobIndex = 0;
+			{
+				std::lock_guard lock(pendingMutex);
+				if (pendingJobs.empty()) {
+					break;
+				}
+				jobIndex = pendingJobs.front();
+				pendingJobs.pop_front();
+			}
+
+			std::optional<std::vector<std::byte>> response;
+			if (sendMessage(fd, compileJobMagic, serializeCompileJob(jobs[jobIndex]))) {
+				response = receiveMessage(fd, compileResultMagic);
+			}
+
+			auto result = response.has_value() ? deserializeCompileJobResult(*response) : std::nullopt;
+			if (!result.has_value()) {
+				// Give the job back so that another worker can pick it up.
+				std::cerr << "Lost connection to worker " << address << std::endl;
+				std::lock_guard lock(pendingMutex);
+				pendingJobs.push_back(jobIndex);
+				break;
+			}
+			results[jobIndex] = std::move(result);
+		}
+		::close(fd);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(workerAddresses.size());
+	for (const auto& address : workerAddresses) {
+		threads.emplace_back(runWorker, std::cref(address));
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	return results;
+}
+
+std::vector<std::optional<shaders::CompileJobResult>> shaders::executeProcessCompileJobs(std::uint32_t processCount,
+                                                                                        std::span<const CompileJob> jobs,
+                                                                                        std::span<const std::size_t> order,
+                                                                                        std::span<std::chrono::microseconds> durations,
+                                                                                        const JobServerClient* jobServer) {
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::vector<std::optional<CompileJobResult>> results(jobs.size());
+
+	// All processes are forked before any thread is started.
+	std::vector<WorkerProcess> workers;
+	auto workerCount = std::min<std::size_t>(std::max<std::uint32_t>(processCount, 1U), order.size());
+	for (std::size_t i = 0; i < workerCount; ++i) {
+		std::array<int, 2> fds = {};
+		if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) != 0) {
+			std::cerr << "Failed to create socket for worker process: " << std::strerror(errno) << std::endl;
+			break;
+		}
+		auto* shared = ::mmap(nullptr, sharedResultSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (shared == MAP_FAILED) {
+			std::cerr << "Failed to map memory for worker process: " << std::strerror(errno) << std::endl;
+			::close(fds[0]);
+			::close(fds[1]);
+			break;
+		}
+		std::span sharedResult { static_cast<std::byte*>(shared), sharedResultSize };
+
+		auto pid = ::fork();
+		if (pid == 0) {
+			// The sockets of the other workers have to be closed, so that they see when the parent closes them.
+			::close(fds[0]);
+			for (const auto& worker : workers) {
+				::close(worker.fd);
+			}
+			runWorkerProcess(fds[1], sharedResult);
+		}
+
+		::close(fds[1]);
+		if (pid < 0) {
+			std::cerr << "Failed to start worker process: " << std::strerror(errno) << std::endl;
+			::close(fds[0]);
+			::munmap(shared, sharedResultSize);
+			break;
+		}
+		workers.emplace_back(WorkerProcess { .pid = pid, .fd = fds[0], .sharedResult = sharedResult });
+	}
+
+	std::mutex pendingMutex;
+	std::deque<std::size_t> pendingJobs(order.begin(), order.end());
+	auto hasPendingJobs = [&]() {
+		std::lock_guard lock(pendingMutex);
+		return !pendingJobs.empty();
+	};
+
+	// Like the compile threads, every worker beyond the first needs a jobserver token for each job.
+	auto runWorker = [&](WorkerProcess& worker, bool needsToken) {
+		while (true) {
+			std::optional<std::byte> token;
+			if (needsToken && jobServer != nullptr) {
+				token = jobServer->acquire(hasPendingJobs);
+				if (!token.has_value()) {
+					break;
+				}
+			}
+
+			std::optional<std::size_t> jobIndex;
+			{
+				std::lock_guard lock(pendingMutex);
+				if (!pendingJobs.empty()) {
+					jobIndex = pendingJobs.front();
+					pendingJobs.pop_front();
+				}
+			}
+
+			std::optional<std::vector<std::byte>> response;
+			auto start = std::chrono::steady_clock::now();
+			if (jobIndex.has_value() && sendMessage(worker.fd, compileJobMagic, serializeCompileJob(jobs[*jobIndex]))) {
+				response = receiveMessage(worker.fd, compileResultMagic);
+			}
+			if (token.has_value()) {
+				jobServer->release(*token);
+			}
+			if (!jobIndex.has_value()) {
+				break;
+			}
+
+			if (!response.has_value()) {
+				// The process most likely crashed in the compiler, so the job would only crash the next one too.
+				int status = 0;
+				::waitpid(worker.pid, &status, 0);
+				worker.pid = -1;
+				std::cerr << ">> Worker process crashed";
+				if (WIFSIGNALED(status)) {
+					std::cerr << " with signal " << WTERMSIG(status);
+				}
+				std::cerr << " while compiling " << jobs[*jobIndex].sourcePath << std::endl;
+				results[*jobIndex] = CompileJobResult {};
+				break;
+			}
+
+			results[*jobIndex] = response->empty() ? deserializeCompileJobResult(worker.sharedResult) : deserializeCompileJobResult(*response);
+			durations[*jobIndex] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		}
+		::close(worker.fd);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(workers.size());
+	for (std::size_t i = 0; i < workers.size(); ++i) {
+		threads.emplace_back(runWorker, std::ref(workers[i]), i != 0);
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	// The workers exit once their socket is closed.
+	for (const auto& worker : workers) {
+		if (worker.pid > 0) {
+			::waitpid(worker.pid, nullptr, 0);
+		}
+		::munmap(worker.sharedResult.data(), worker.sharedResult.size());
+	}
+	return results;
+}
@@ -1,19 +1,292 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <numeric>
+#include <optional>
 #include <span>
+#include <type_traits>
 
 #include <shaders/shader_binary.hpp>
+#include <shaders/shader_constants.hpp>
+#include <shaders/spirv_codec.hpp>
 
 namespace fs = std::filesystem;
 namespace ks = ::shaders;
 
+namespace {
+	[[nodiscard]] constexpr std::size_t alignUp(std::size_t value, std::size_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Checks the magic and version, which have to be valid before any other field of the header can be trusted.
+	bool isHeaderSupported(const ks::ShaderFileHeader& header) {
+		if (header.magic != ks::headerMagic) {
+			std::string_view magic = { reinterpret_cast<const char*>(&header.magic), 4 };
+			std::string_view correctMagic = { reinterpret_cast<const char*>(&ks::headerMagic), 4 };
+			std::cerr << "Invalid magic header on shader binary file: " << magic << " != " << correctMagic << std::endl;
+			return false;
+		}
+
+		if (header.version != ks::headerVersion) {
+			std::cerr << "Unsupported shader binary version: " << header.version << " != " << ks::headerVersion << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Reads the whole file with a single read call. Returns an empty vector on failure.
+	std::vector<std::byte> readBinaryFile(const fs::path& path, std::size_t minimumSize) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+		auto length = file.tellg();
+		file.seekg(0, std::ifstream::beg);
+
+		if (length <= 0 || file.fail()) {
+			std::cerr << "Failed to open shader binary file: " << path << std::endl;
+			return {};
+		}
+
+		if (static_cast<std::size_t>(length) < minimumSize) {
+			std::cerr << "Shader binary file too small: " << length << " bytes" << std::endl;
+			return {};
+		}
+
+		std::vector<std::byte> bytes(static_cast<std::size_t>(length));
+		file.read(reinterpret_cast<char*>(bytes.data()), length);
+		if (file.fail()) {
+			std::cerr << "Failed to read shader binary file: " << path << std::endl;
+			return {};
+		}
+		return bytes;
+	}
+
+	// Returns a view of the null-terminated string at the given offset, or an empty optional if the
+	// string is out of bounds or not terminated within the buffer.
+	[[nodiscard]] std::optional<std::string_view> readString(std::span<const std::byte> bytes, std::uint64_t offset) {
+		if (offset >= bytes.size()) {
+			return std::nullopt;
+		}
+
+		const auto* begin = reinterpret_cast<const char*>(bytes.data() + offset);
+		const auto* end = static_cast<const char*>(std::memchr(begin, '\0', bytes.size() - offset));
+		if (end == nullptr) {
+			return std::nullopt;
+		}
+		return std::string_view { begin, static_cast<std::size_t>(end - begin) };
+	}
+
+	[[nodiscard]] std::size_t getReflectionByteSize(const ks::ShaderReflectionData& reflection) {
+		if (reflection.descriptorBindings.empty() && reflection.pushConstantRanges.empty() && reflection.vertexInputs.empty()
+		    && reflection.workgroupSize == std::array<std::uint32_t, 3> {}) {
+			return 0;
+		}
+
+		return sizeof(ks::ShaderReflectionHeader) + reflection.descriptorBindings.size() * sizeof(ks::ReflectedDescriptorBinding)
+		       + reflection.pushConstantRanges.size() * sizeof(ks::ReflectedPushConstantRange)
+		       + reflection.vertexInputs.size() * sizeof(ks::ReflectedVertexInput);
+	}
+
+	// Everything that is copied into the output with memcpy must not contain padding, as the contents of padding
+	// bytes are unspecified and would make the output differ between builds.
+	static_assert(std::has_unique_object_representations_v<ks::ShaderFileHeader>);
+	static_assert(std::has_unique_object_representations_v<ks::ShaderGroupDescription>);
+	static_assert(std::has_unique_object_representations_v<ks::ShaderBundleHeader>);
+	static_assert(std::has_unique_object_representations_v<ks::ShaderBundleEntry>);
+	static_assert(std::has_unique_object_representations_v<ks::ShaderReflectionHeader>);
+	static_assert(std::has_unique_object_representations_v<ks::ReflectedDescriptorBinding>);
+	static_assert(std::has_unique_object_representations_v<ks::ReflectedPushConstantRange>);
+	static_assert(std::has_unique_object_representations_v<ks::ReflectedVertexInput>);
+
+	// ShaderDescription has padding after its last member, which even a zero-initialized struct may not keep
+	// zeroed, as compilers can merge the stores of the small members into wider ones. Copying every member on
+	// its own leaves the padding as the zeroes already in the output.
+	void writeDescription(std::byte* output, const ks::ShaderDescription& description) {
+		auto writeMember = [output](std::size_t offset, const auto& member) {
+			std::memcpy(output + offset, &member, sizeof member);
+		};
+		writeMember(offsetof(ks::ShaderDescription, byteOffset), description.byteOffset);
+		writeMember(offsetof(ks::ShaderDescription, byteSize), description.byteSize);
+		writeMember(offsetof(ks::ShaderDescription, nameByteOffset), description.nameByteOffset);
+		writeMember(offsetof(ks::ShaderDescription, shaderNameByteOffset), description.shaderNameByteOffset);
+		writeMember(offsetof(ks::ShaderDescription, reflectionByteOffset), description.reflectionByteOffset);
+		writeMember(offsetof(ks::ShaderDescription, reflectionByteSize), description.reflectionByteSize);
+		writeMember(offsetof(ks::ShaderDescription, hash), description.hash);
+		writeMember(offsetof(ks::ShaderDescription, stage), description.stage);
+		writeMember(offsetof(ks::ShaderDescription, lang), description.lang);
+		writeMember(offsetof(ks::ShaderDescription, codec), description.codec);
+		writeMember(offsetof(ks::ShaderDescription, group), description.group);
+		writeMember(offsetof(ks::ShaderDescription, spirvVersion), description.spirvVersion);
+	}
+
+	[[nodiscard]] ks::ContentHash hashLayout(std::span<const ks::ShaderInput> inputs) {
+		std::vector<std::byte> layout;
+		auto append = [&layout](const void* data, std::size_t size) {
+			const auto* begin = static_cast<const std::byte*>(data);
+			layout.insert(layout.end(), begin, begin + size);
+		};
+		for (const auto& input : inputs) {
+			// The null terminators keep the boundaries between the names unambiguous.
+			append(input.shaderName.c_str(), input.shaderName.size() + 1);
+			append(input.name.c_str(), input.name.size() + 1);
+			append(&input.stage, sizeof input.stage);
+			append(&input.lang, sizeof input.lang);
+			append(&input.spirvVersion, sizeof input.spirvVersion);
+		}
+		return ks::hashContent(layout);
+	}
+
+	void writeReflection(std::byte* output, const ks::ShaderReflectionData& reflection) {
+		ks::ShaderReflectionHeader header = {
+			.workgroupSize = reflection.workgroupSize,
+			.descriptorBindingCount = static_cast<std::uint32_t>(reflection.descriptorBindings.size()),
+			.pushConstantRangeCount = static_cast<std::uint32_t>(reflection.pushConstantRanges.size()),
+			.vertexInputCount = static_cast<std::uint32_t>(reflection.vertexInputs.size()),
+		};
+
+		auto write = [&output](const void* data, std::size_t size) mutable {
+			std::memcpy(output, data, size);
+			output += size;
+		};
+		write(&header, sizeof header);
+		write(reflection.descriptorBindings.data(), reflection.descriptorBindings.size() * sizeof(ks::ReflectedDescriptorBinding));
+		write(reflection.pushConstantRanges.data(), reflection.pushConstantRanges.size() * sizeof(ks::ReflectedPushConstantRange));
+		write(reflection.vertexInputs.data(), reflection.vertexInputs.size() * sizeof(ks::ReflectedVertexInput));
+	}
+
+	// Creates views into the reflection section. The section is aligned when writing, so the arrays
+	// can be used in place.
+	[[nodiscard]] std::optional<ks::ShaderReflection> readReflection(std::span<const std::byte> section) {
+		ks::ShaderReflection reflection = {};
+		if (section.empty()) {
+			return reflection;
+		}
+
+		if (section.size() < sizeof(ks::ShaderReflectionHeader)
+		    || reinterpret_cast<std::uintptr_t>(section.data()) % alignof(ks::ShaderReflectionHeader) != 0) {
+			return std::nullopt;
+		}
+
+		ks::ShaderReflectionHeader header = {};
+		std::memcpy(&header, section.data(), sizeof header);
+
+		auto arraysSize = header.descriptorBindingCount * sizeof(ks::ReflectedDescriptorBinding)
+		                  + header.pushConstantRangeCount * sizeof(ks::ReflectedPushConstantRange)
+		                  + header.vertexInputCount * sizeof(ks::ReflectedVertexInput);
+		if (section.size() - sizeof header < arraysSize) {
+			return std::nullopt;
+		}
+
+		const auto* data = section.data() + sizeof header;
+		reflection.workgroupSize = header.workgroupSize;
+		reflection.descriptorBindings = { reinterpret_cast<const ks::ReflectedDescriptorBinding*>(data), header.descriptorBindingCount };
+		data += reflection.descriptorBindings.size_bytes();
+		reflection.pushConstantRanges = { reinterpret_cast<const ks::ReflectedPushConstantRange*>(data), header.pushConstantRangeCount };
+		data += reflection.pushConstantRanges.size_bytes();
+		reflection.vertexInputs = { reinterpret_cast<const ks::ReflectedVertexInput*>(data), header.vertexInputCount };
+		return reflection;
+	}
+
+	// Points the given binaries at their bytes and reflection sections, where the bytes start at baseOffset in the file.
+	// All encoded binaries are decoded into the decoded storage, whose size is known from their headers.
+	[[nodiscard]] bool readPayloads(std::span<const std::byte> bytes, std::uint64_t baseOffset, std::span<const ks::ShaderDescription> descriptions,
+	                                std::span<const std::size_t> indices, std::span<ks::ShaderBinary> binaries,
+	                                std::vector<std::uint32_t>& decodedStorage, ks::ShaderLibraryReadFlags flags) {
+		auto getSection = [&](std::uint64_t offset, std::uint64_t size) -> std::optional<std::span<const std::byte>> {
+			if (offset < baseOffset || offset - baseOffset > bytes.size() || size > bytes.size() - (offset - baseOffset)) {
+				return std::nullopt;
+			}
+			return bytes.subspan(offset - baseOffset, size);
+		};
+
+		std::vector<std::size_t> decodedOffsets(indices.size());
+		std::size_t decodedWordCount = 0;
+		for (std::size_t i = 0; i < indices.size(); ++i) {
+			const auto& desc = descriptions[indices[i]];
+			if (desc.codec == ks::ShaderCodec::None) {
+				continue;
+			}
+
+			std::optional<std::size_t> wordCount;
+			if (auto section = getSection(desc.byteOffset, desc.byteSize); desc.codec == ks::ShaderCodec::CompactSpirv && section.has_value()) {
+				wordCount = ks::getCompactSpirvWordCount(*section);
+			}
+			if (!wordCount.has_value()) {
+				std::cerr << "Invalid encoding of shader description " << indices[i] << std::endl;
+				return false;
+			}
+
+			decodedOffsets[i] = decodedWordCount;
+			// Every binary starts at a multiple of the binary alignment, like in the file.
+			decodedWordCount += alignUp(*wordCount, ks::shaderBinaryAlignment / sizeof(std::uint32_t));
+		}
+		decodedStorage.resize(decodedWordCount);
+
+		auto verifyHashes = (flags & ks::ShaderLibraryReadFlags::VerifyHashes) == ks::ShaderLibraryReadFlags::VerifyHashes;
+		for (std::size_t i = 0; i < indices.size(); ++i) {
+			auto& binary = binaries[indices[i]];
+			const auto& desc = descriptions[indices[i]];
+
+			auto stored = getSection(desc.byteOffset, desc.byteSize);
+			auto reflectionSection = getSection(desc.reflectionByteOffset, desc.reflectionByteSize);
+			if (!stored.has_value() || !reflectionSection.has_value()) {
+				std::cerr << "Shader description " << indices[i] << " points outside of the shader binary" << std::endl;
+				return false;
+			}
+
+			auto reflection = readReflection(*reflectionSection);
+			if (!reflection.has_value()) {
+				std::cerr << "Invalid reflection data for shader description " << indices[i] << std::endl;
+				return false;
+			}
+
+			binary.bytes = *stored;
+			if (desc.codec != ks::ShaderCodec::None) {
+				std::span<std::uint32_t> words { decodedStorage.data() + decodedOffsets[i], *ks::getCompactSpirvWordCount(*stored) };
+				if (!ks::decodeCompactSpirv(*stored, words)) {
+					std::cerr << "Failed to decode shader \"" << binary.shaderName << "\"" << std::endl;
+					return false;
+				}
+				binary.bytes = std::as_bytes(words);
+			}
+			binary.reflection = *reflection;
+
+			if (verifyHashes && ks::hashContent(binary.bytes) != binary.hash) {
+				std::cerr << "Content hash mismatch for shader \"" << binary.shaderName << "\"" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+} // namespace
+
 std::span<const std::string_view> shaders::ShaderLibrary::getShaderNames() const {
 	return shaderNames;
 }
 
-const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByName(std::string_view shaderName) {
-	auto it = std::find_if(binaries.begin(), binaries.end(), [&shaderName](ShaderBinary& binary) {
+std::span<const shaders::ShaderBinary> shaders::ShaderLibrary::getShaderBinaries() const {
+	return binaries;
+}
+
+shaders::ContentHash shaders::ShaderLibrary::getLayoutHash() const {
+	return layoutHash;
+}
+
+std::span<const std::string_view> shaders::ShaderLibrary::getGroupNames() const {
+	return groupNames;
+}
+
+const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByIndex(std::size_t index) const {
+	if (index >= binaries.size()) {
+		return nullptr;
+	}
+	return &binaries[index];
+}
+
+const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByName(std::string_view shaderName) const {
+	auto it = std::find_if(binaries.begin(), binaries.end(), [&shaderName](const ShaderBinary& binary) {
 		return binary.shaderName == shaderName;
 	});
 
@@ -23,8 +296,25 @@ const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByName(std::
 	return &(*it);
 }
 
-const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByStage(shaders::ShaderStage stage) {
-	auto it = std::find_if(binaries.begin(), binaries.end(), [&stage](ShaderBinary& binary) {
+const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryForTarget(std::string_view shaderName, ShaderLang lang,
+                                                                           SPVVersion maxSpirvVersion) const {
+	const ShaderBinary* result = nullptr;
+	for (const auto& binary : binaries) {
+		if (binary.shaderName != shaderName || binary.lang != lang) {
+			continue;
+		}
+		if (lang != ShaderLang::SPIRV) {
+			return &binary;
+		}
+		if (binary.spirvVersion <= maxSpirvVersion && (result == nullptr || binary.spirvVersion > result->spirvVersion)) {
+			result = &binary;
+		}
+	}
+	return result;
+}
+
+const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByStage(shaders::ShaderStage stage) const {
+	auto it = std::find_if(binaries.begin(), binaries.end(), [&stage](const ShaderBinary& binary) {
 		return binary.stage == stage;
 	});
 
@@ -34,29 +324,86 @@ const shaders::ShaderBinary* shaders::ShaderLibrary::getShaderBinaryByStage(shad
 	return &(*it);
 }
 
-std::vector<std::byte> shaders::buildShaderLibrary(std::vector<ShaderInput>&& inputs) {
+std::vector<std::byte> shaders::buildShaderLibrary(std::vector<ShaderInput>&& inputs, std::span<const std::size_t> placement) {
 	// We're not going to profile the shader_preprocessor.exe, so we'll not mark this as a zone.
 	auto inputCount = static_cast<std::uint16_t>(inputs.size()); // This will also limit it.
 
-	std::vector<std::byte> output;
+	// The groups are stored in the order they first appear in the placement, and the shaders within
+	// every group keep their relative order from the placement.
+	std::vector<std::size_t> dataOrder(inputCount);
+	if (placement.size() == inputCount) {
+		std::copy(placement.begin(), placement.end(), dataOrder.begin());
+	} else {
+		std::iota(dataOrder.begin(), dataOrder.end(), 0);
+	}
+
+	std::vector<std::string_view> groupNames;
+	std::vector<ShaderDescription> descriptions(inputCount);
+	for (auto index : dataOrder) {
+		auto it = std::find(groupNames.begin(), groupNames.end(), inputs[index].group);
+		descriptions[index].group = static_cast<std::uint16_t>(std::distance(groupNames.begin(), it));
+		if (it == groupNames.end()) {
+			groupNames.emplace_back(inputs[index].group);
+		}
+	}
+	std::stable_sort(dataOrder.begin(), dataOrder.end(), [&descriptions](std::size_t lhs, std::size_t rhs) {
+		return descriptions[lhs].group < descriptions[rhs].group;
+	});
+
+	// Calculate the byte offsets for each component first. The index consists of the header, the descriptions,
+	// the groups and all names with their null terminators. It is followed by the binaries and reflection
+	// sections of every group, which are all padded to the binary alignment.
+	std::vector<ShaderGroupDescription> groups(groupNames.size());
+	std::vector<std::vector<std::byte>> encodedBytes(inputCount);
+	auto dataOffset = sizeof(ShaderFileHeader) + sizeof(ShaderDescription) * inputCount + sizeof(ShaderGroupDescription) * groups.size();
+	for (auto i = 0U; i < inputCount; ++i) {
+		const auto& input = inputs[i];
+		auto& description = descriptions[i];
+		description.nameByteOffset = dataOffset;
+		description.shaderNameByteOffset = description.nameByteOffset + input.name.size() + 1;
+		dataOffset = description.shaderNameByteOffset + input.shaderName.size() + 1;
+	}
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		groups[i].nameByteOffset = dataOffset;
+		dataOffset += groupNames[i].size() + 1;
+	}
 
-	size_t totalShaderByteSize = 0;
-	for (const auto& input : inputs) {
-		totalShaderByteSize += input.shaderBytes.size();
-		totalShaderByteSize += input.shaderName.size() + 1;
-		totalShaderByteSize += input.name.size() + 1;
+	dataOffset = alignUp(dataOffset, shaderBinaryAlignment);
+	auto indexByteSize = static_cast<std::uint32_t>(dataOffset);
+	for (auto i : dataOrder) {
+		const auto& input = inputs[i];
+		auto& description = descriptions[i];
+
+		description.codec = ShaderCodec::None;
+		if (input.codec == ShaderCodec::CompactSpirv && input.lang == ShaderLang::SPIRV) {
+			if (auto encoded = encodeCompactSpirv(input.shaderBytes); encoded.has_value()) {
+				encodedBytes[i] = std::move(*encoded);
+				description.codec = ShaderCodec::CompactSpirv;
+			}
+		}
+		auto storedBytes = description.codec == ShaderCodec::None ? std::span<const std::byte> { input.shaderBytes } : encodedBytes[i];
+
+		auto& group = groups[description.group];
+		if (group.byteSize == 0) {
+			group.byteOffset = dataOffset;
+		}
+		description.byteOffset = dataOffset;
+		description.byteSize = storedBytes.size();
+		description.reflectionByteOffset = alignUp(description.byteOffset + description.byteSize, shaderBinaryAlignment);
+		description.reflectionByteSize = getReflectionByteSize(input.reflection);
+		description.hash = hashContent(input.shaderBytes);
+		description.stage = input.stage;
+		description.lang = input.lang;
+		description.spirvVersion = input.spirvVersion;
+		dataOffset = alignUp(description.reflectionByteOffset + description.reflectionByteSize, shaderBinaryAlignment);
+		group.byteSize = dataOffset - group.byteOffset;
 	}
 
-	// Reserve enough space for the whole file.
-	// clang-format off
-	output.resize(sizeof(ShaderFileHeader) +
-	              sizeof(ShaderDescription) * inputCount +
-	              totalShaderByteSize);
-	// clang-format on
+	// Resizing zero-initializes, which also takes care of the null terminators and padding.
+	std::vector<std::byte> output(dataOffset);
 
-	auto write = [output = output.data()](const void* data, std::size_t size) mutable {
-		std::memcpy(output, data, size);
-		output += size;
+	auto write = [&output](std::size_t offset, const void* data, std::size_t size) {
+		std::memcpy(output.data() + offset, data, size);
 	};
 
 	// Write the file header.
@@ -64,97 +411,362 @@ std::vector<std::byte> shaders::buildShaderLibrary(std::vector<ShaderInput>&& in
 		ShaderFileHeader header = {
 			.magic = headerMagic,
 			.shaderCount = inputCount,
+			.version = headerVersion,
+			.layoutHash = hashLayout(inputs),
+			.groupCount = static_cast<std::uint16_t>(groups.size()),
+			.reserved = 0,
+			.indexByteSize = indexByteSize,
 		};
-		write(&header, sizeof header);
+		write(0, &header, sizeof header);
 	}
 
-	// Write shader description headers. We also calculate the byte offsets for each component.
-	auto data_offset = sizeof(ShaderFileHeader) + sizeof(ShaderDescription) * inputCount;
-	for (const auto& input : inputs) {
-		ShaderDescription description = {
-			.byteOffset = data_offset + input.shaderName.size() + input.name.size(),
-			.byteSize = input.shaderBytes.size(),
-			.nameByteOffset = data_offset,
-			.shaderNameByteOffset = data_offset + input.name.size(),
-			.stage = input.stage,
-			.lang = input.lang,
-		};
-		write(&description, sizeof description);
-		data_offset = description.byteOffset + description.byteSize;
+	// Write the shader description headers and all the data.
+	for (auto i = 0U; i < inputCount; ++i) {
+		const auto& input = inputs[i];
+		const auto& description = descriptions[i];
+		writeDescription(output.data() + sizeof(ShaderFileHeader) + sizeof(ShaderDescription) * i, description);
+		write(description.nameByteOffset, input.name.data(), input.name.size());
+		write(description.shaderNameByteOffset, input.shaderName.data(), input.shaderName.size());
+		const auto& storedBytes = description.codec == ShaderCodec::None ? input.shaderBytes : encodedBytes[i];
+		write(description.byteOffset, storedBytes.data(), storedBytes.size());
+		if (description.reflectionByteSize != 0) {
+			writeReflection(output.data() + description.reflectionByteOffset, input.reflection);
+		}
 	}
 
-	// Now that we've written all the headers, we begin writing all the data.
-	for (const auto& input : inputs) {
-		write(input.name.data(), input.name.size());
-		write(input.shaderName.data(), input.shaderName.size());
-		write(input.shaderBytes.data(), input.shaderBytes.size());
+	auto groupsOffset = sizeof(ShaderFileHeader) + sizeof(ShaderDescription) * inputCount;
+	for (std::size_t i = 0; i < groups.size(); ++i) {
+		write(groupsOffset + sizeof(ShaderGroupDescription) * i, &groups[i], sizeof(ShaderGroupDescription));
+		write(groups[i].nameByteOffset, groupNames[i].data(), groupNames[i].size());
 	}
 
 	return output;
 }
 
-shaders::ShaderLibrary shaders::readShaderLibraryFromFile(const fs::path& path) {
-	std::ifstream file(path, std::ios::binary | std::ios::ate);
+bool shaders::ShaderLibrary::parseIndex(std::span<const std::byte> bytes, ShaderLibrary& library, std::vector<ShaderDescription>& descriptions,
+                                        std::vector<ShaderGroupDescription>& groups) {
+	if (bytes.size() < sizeof(ShaderFileHeader)) {
+		std::cerr << "Shader binary too small: " << bytes.size() << " bytes" << std::endl;
+		return false;
+	}
+
+	ShaderFileHeader header = {};
+	std::memcpy(&header, bytes.data(), sizeof header);
+	if (!isHeaderSupported(header)) {
+		return false;
+	}
+
+	auto groupsOffset = sizeof(ShaderFileHeader) + sizeof(ShaderDescription) * header.shaderCount;
+	if (bytes.size() < header.indexByteSize || header.indexByteSize < groupsOffset + sizeof(ShaderGroupDescription) * header.groupCount) {
+		std::cerr << "Shader binary too small for " << header.shaderCount << " shaders" << std::endl;
+		return false;
+	}
 
-	auto length = file.tellg();
-	file.seekg(0, std::ifstream::beg);
+	library.layoutHash = header.layoutHash;
+
+	// The descriptions are copied out, as the given memory might not be sufficiently aligned.
+	descriptions.resize(header.shaderCount);
+	std::memcpy(descriptions.data(), bytes.data() + sizeof(ShaderFileHeader), sizeof(ShaderDescription) * header.shaderCount);
+	groups.resize(header.groupCount);
+	std::memcpy(groups.data(), bytes.data() + groupsOffset, sizeof(ShaderGroupDescription) * header.groupCount);
+
+	// All names are part of the index.
+	auto index = bytes.first(header.indexByteSize);
+	library.groupNames.resize(header.groupCount);
+	for (auto i = 0U; i < header.groupCount; ++i) {
+		auto groupName = readString(index, groups[i].nameByteOffset);
+		if (!groupName.has_value()) {
+			std::cerr << "Shader group " << i << " points outside of the shader binary" << std::endl;
+			return false;
+		}
+		library.groupNames[i] = *groupName;
+	}
 
-	if (length <= 0 || file.fail()) {
+	library.shaderNames.resize(header.shaderCount);
+	library.binaries.resize(header.shaderCount);
+	for (auto i = 0U; i < header.shaderCount; ++i) {
+		auto& binary = library.binaries[i];
+		const auto& desc = descriptions[i];
+
+		auto name = readString(index, desc.nameByteOffset);
+		auto shaderName = readString(index, desc.shaderNameByteOffset);
+		if (!name.has_value() || !shaderName.has_value() || desc.group >= header.groupCount) {
+			std::cerr << "Shader description " << i << " points outside of the shader binary" << std::endl;
+			return false;
+		}
+
+		binary.stage = desc.stage;
+		binary.lang = desc.lang;
+		binary.spirvVersion = desc.spirvVersion;
+		binary.codec = desc.codec;
+		binary.name = *name;
+		binary.shaderName = *shaderName;
+		binary.group = library.groupNames[desc.group];
+		binary.hash = desc.hash;
+		library.shaderNames[i] = binary.shaderName;
+	}
+
+	return true;
+}
+
+bool shaders::ShaderLibrary::parse(std::span<const std::byte> bytes, ShaderLibrary& library, ShaderLibraryReadFlags flags) {
+	// The binaries and reflection data are used in place, which requires the same alignment as when writing.
+	if (reinterpret_cast<std::uintptr_t>(bytes.data()) % shaderBinaryAlignment != 0) {
+		std::cerr << "Shader binary memory is not aligned to " << shaderBinaryAlignment << " bytes" << std::endl;
+		return false;
+	}
+
+	std::vector<ShaderDescription> descriptions;
+	std::vector<ShaderGroupDescription> groups;
+	if (!parseIndex(bytes, library, descriptions, groups)) {
+		return false;
+	}
+
+	std::vector<std::size_t> indices(descriptions.size());
+	std::iota(indices.begin(), indices.end(), 0);
+	return readPayloads(bytes, 0, descriptions, indices, library.binaries, library.decodedStorage, flags);
+}
+
+shaders::ShaderLibrary shaders::readShaderLibraryFromFile(const fs::path& path, ShaderLibraryReadFlags flags) {
+	ShaderLibrary library;
+	library.storage = readBinaryFile(path, sizeof(ShaderFileHeader));
+	if (library.storage.empty() || !ShaderLibrary::parse(library.storage, library, flags)) {
+		return {};
+	}
+	return library;
+}
+
+shaders::ShaderLibrary shaders::readShaderLibraryFromMemory(std::span<const std::byte> bytes, ShaderLibraryReadFlags flags) {
+	ShaderLibrary library;
+	if (!ShaderLibrary::parse(bytes, library, flags)) {
+		return {};
+	}
+	return library;
+}
+
+shaders::ShaderLibraryReader shaders::openShaderLibrary(const fs::path& path, ShaderLibraryReadFlags flags) {
+	ShaderLibraryReader reader;
+	reader.file.open(path, std::ios::binary);
+	ShaderFileHeader header = {};
+	reader.file.read(reinterpret_cast<char*>(&header), sizeof header);
+	if (reader.file.fail()) {
 		std::cerr << "Failed to open shader binary file: " << path << std::endl;
 		return {};
 	}
 
-	if (length < sizeof(ShaderFileHeader)) {
-		std::cerr << "Shader binary file too small: " << length << " bytes" << std::endl;
+	// The header tells how large the index is, which is then read with a second read. The size is only trusted once
+	// the header is known to be valid, and never allocates more than the file could hold.
+	if (!isHeaderSupported(header)) {
+		return {};
+	}
+	std::error_code error;
+	auto fileSize = fs::file_size(path, error);
+	if (error || header.indexByteSize > fileSize) {
+		std::cerr << "Shader binary too small for its index: " << path << std::endl;
 		return {};
 	}
 
-	// This assumes that we read everything in linear order. So this needs changing should the
-	// write function ever change.
-	auto read = [&file](void* data, std::size_t size) mutable [[gnu::always_inline]] { file.read(reinterpret_cast<char*>(data), size); };
+	auto& storage = reader.library.storage;
+	storage.resize(std::max<std::size_t>(header.indexByteSize, sizeof header));
+	std::memcpy(storage.data(), &header, sizeof header);
+	reader.file.read(reinterpret_cast<char*>(storage.data() + sizeof header), static_cast<std::streamsize>(storage.size() - sizeof header));
+	if (reader.file.fail()) {
+		std::cerr << "Failed to read shader binary file: " << path << std::endl;
+		return {};
+	}
 
-	ShaderFileHeader header = {};
-	read(&header, sizeof header);
-	if (header.magic != headerMagic) {
-		std::string_view magic = { reinterpret_cast<char*>(&header.magic), 4 };
-		std::string_view correctMagic = { reinterpret_cast<const char*>(&headerMagic), 4 };
-		std::cerr << "Invalid magic header on shader binary file: " << magic << " != " << correctMagic << std::endl;
+	if (!ShaderLibrary::parseIndex(storage, reader.library, reader.descriptions, reader.groups)) {
 		return {};
 	}
 
-	ShaderLibrary library;
-	library.shaderNames.resize(header.shaderCount);
-	library.binaries.resize(header.shaderCount);
+	// Groups are read on demand with their size from the index, so a group must not extend past the end of the file.
+	for (std::size_t i = 0; i < reader.groups.size(); ++i) {
+		const auto& group = reader.groups[i];
+		if (group.byteSize > fileSize || group.byteOffset > fileSize - group.byteSize) {
+			std::cerr << "Shader binary too small for group \"" << reader.library.groupNames[i] << "\": " << path << std::endl;
+			return {};
+		}
+	}
+	reader.flags = flags;
+	reader.loadedGroups.resize(reader.groups.size());
+	reader.groupStorage.resize(reader.groups.size());
+	reader.decodedGroupStorage.resize(reader.groups.size());
+	return reader;
+}
 
-	std::vector<ShaderDescription> descriptions(header.shaderCount);
+std::optional<std::size_t> shaders::ShaderLibraryReader::findGroup(std::string_view group) const {
+	auto it = std::find(library.groupNames.begin(), library.groupNames.end(), group);
+	if (it == library.groupNames.end()) {
+		return std::nullopt;
+	}
+	return static_cast<std::size_t>(std::distance(library.groupNames.begin(), it));
+}
 
-	// We first read all the shader descriptions
-	for (auto i = 0U; i < header.shaderCount; ++i) {
-		ShaderDescription description = {};
-		read(&description, sizeof description);
-		descriptions[i] = description;
+const shaders::ShaderLibrary& shaders::ShaderLibraryReader::getLibrary() const {
+	return library;
+}
+
+bool shaders::ShaderLibraryReader::isGroupLoaded(std::string_view group) const {
+	auto index = findGroup(group);
+	return index.has_value() && loadedGroups[*index];
+}
+
+bool shaders::ShaderLibraryReader::loadGroup(std::string_view group) {
+	auto index = findGroup(group);
+	if (!index.has_value()) {
+		std::cerr << "Shader library has no group \"" << group << "\"" << std::endl;
+		return false;
+	}
+	if (loadedGroups[*index]) {
+		return true;
 	}
 
-	// Then read all names and binaries.
-	for (auto i = 0U; i < header.shaderCount; ++i) {
-		auto& binary = library.binaries[i];
-		auto& desc = descriptions[i];
+	const auto& groupDesc = groups[*index];
+	auto& bytes = groupStorage[*index];
+	bytes.resize(groupDesc.byteSize);
+	file.clear();
+	file.seekg(static_cast<std::streamoff>(groupDesc.byteOffset));
+	file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+	if (file.fail()) {
+		std::cerr << "Failed to read shader group \"" << group << "\"" << std::endl;
+		bytes = {};
+		return false;
+	}
 
-		binary.stage = desc.stage;
-		binary.lang = desc.lang;
+	std::vector<std::size_t> indices;
+	for (std::size_t i = 0; i < descriptions.size(); ++i) {
+		if (descriptions[i].group == *index) {
+			indices.emplace_back(i);
+		}
+	}
+	if (!readPayloads(bytes, groupDesc.byteOffset, descriptions, indices, library.binaries, decodedGroupStorage[*index], flags)) {
+		unloadGroup(group);
+		return false;
+	}
+	loadedGroups[*index] = true;
+	return true;
+}
+
+void shaders::ShaderLibraryReader::unloadGroup(std::string_view group) {
+	auto index = findGroup(group);
+	if (!index.has_value()) {
+		return;
+	}
 
-		// We read the name first and determine its size by looking where the shader bytes begin.
-		binary.name.resize(desc.shaderNameByteOffset - desc.nameByteOffset);
-		read(binary.name.data(), binary.name.size());
+	for (std::size_t i = 0; i < descriptions.size(); ++i) {
+		if (descriptions[i].group == *index) {
+			library.binaries[i].bytes = {};
+			library.binaries[i].reflection = {};
+		}
+	}
+	groupStorage[*index] = {};
+	decodedGroupStorage[*index] = {};
+	loadedGroups[*index] = false;
+}
 
-		binary.shaderName.resize(desc.byteOffset - desc.shaderNameByteOffset);
-		read(binary.shaderName.data(), binary.shaderName.size());
+std::span<const std::string_view> shaders::ShaderBundle::getLibraryNames() const {
+	return libraryNames;
+}
 
-		binary.bytes.resize(desc.byteSize);
-		read(binary.bytes.data(), binary.bytes.size());
+const shaders::ShaderLibrary* shaders::ShaderBundle::getLibraryByName(std::string_view libraryName) const {
+	auto it = std::find(libraryNames.begin(), libraryNames.end(), libraryName);
+	if (it == libraryNames.end()) {
+		return nullptr;
+	}
+	return &libraries[std::distance(libraryNames.begin(), it)];
+}
 
-		library.shaderNames[i] = binary.shaderName;
+const shaders::ShaderBinary* shaders::ShaderBundle::getShaderBinary(std::string_view libraryName, std::string_view shaderName) const {
+	const auto* library = getLibraryByName(libraryName);
+	if (library == nullptr) {
+		return nullptr;
+	}
+	return library->getShaderBinaryByName(shaderName);
+}
+
+std::vector<std::byte> shaders::buildShaderBundle(std::vector<ShaderBundleInput>&& inputs) {
+	auto inputCount = static_cast<std::uint16_t>(inputs.size());
+
+	// The index is followed by all library names, after which the libraries follow each other.
+	std::vector<ShaderBundleEntry> entries(inputCount);
+	auto dataOffset = sizeof(ShaderBundleHeader) + sizeof(ShaderBundleEntry) * inputCount;
+	for (auto i = 0U; i < inputCount; ++i) {
+		entries[i].nameByteOffset = dataOffset;
+		dataOffset += inputs[i].name.size() + 1;
+	}
+	for (auto i = 0U; i < inputCount; ++i) {
+		entries[i].byteOffset = alignUp(dataOffset, shaderBinaryAlignment);
+		entries[i].byteSize = inputs[i].libraryBytes.size();
+		dataOffset = entries[i].byteOffset + entries[i].byteSize;
 	}
 
-	return library;
+	std::vector<std::byte> output(dataOffset);
+
+	auto write = [&output](std::size_t offset, const void* data, std::size_t size) {
+		std::memcpy(output.data() + offset, data, size);
+	};
+
+	{
+		ShaderBundleHeader header = {
+			.magic = bundleHeaderMagic,
+			.libraryCount = inputCount,
+			.version = headerVersion,
+		};
+		write(0, &header, sizeof header);
+	}
+
+	write(sizeof(ShaderBundleHeader), entries.data(), entries.size() * sizeof(ShaderBundleEntry));
+	for (auto i = 0U; i < inputCount; ++i) {
+		write(entries[i].nameByteOffset, inputs[i].name.data(), inputs[i].name.size());
+		write(entries[i].byteOffset, inputs[i].libraryBytes.data(), inputs[i].libraryBytes.size());
+	}
+
+	return output;
+}
+
+shaders::ShaderBundle shaders::readShaderBundleFromFile(const fs::path& path, ShaderLibraryReadFlags flags) {
+	ShaderBundle bundle;
+	bundle.storage = readBinaryFile(path, sizeof(ShaderBundleHeader));
+	if (bundle.storage.empty()) {
+		return {};
+	}
+
+	std::span<const std::byte> bytes = bundle.storage;
+
+	ShaderBundleHeader header = {};
+	std::memcpy(&header, bytes.data(), sizeof header);
+	if (header.magic != bundleHeaderMagic || header.version != headerVersion) {
+		std::cerr << "Invalid header on shader bundle file: " << path << std::endl;
+		return {};
+	}
+
+	if (bytes.size() < sizeof(ShaderBundleHeader) + sizeof(ShaderBundleEntry) * header.libraryCount) {
+		std::cerr << "Shader bundle file too small for " << header.libraryCount << " libraries" << std::endl;
+		return {};
+	}
+
+	std::vector<ShaderBundleEntry> entries(header.libraryCount);
+	std::memcpy(entries.data(), bytes.data() + sizeof(ShaderBundleHeader), sizeof(ShaderBundleEntry) * header.libraryCount);
+
+	bundle.libraryNames.resize(header.libraryCount);
+	bundle.libraries.resize(header.libraryCount);
+	for (auto i = 0U; i < header.libraryCount; ++i) {
+		const auto& entry = entries[i];
+
+		auto name = readString(bytes, entry.nameByteOffset);
+		if (!name.has_value() || entry.byteOffset > bytes.size() || entry.byteSize > bytes.size() - entry.byteOffset) {
+			std::cerr << "Shader bundle entry " << i << " points outside of the bundle" << std::endl;
+			return {};
+		}
+
+		// The libraries only view into the bundle's storage, so nothing is copied here.
+		bundle.libraryNames[i] = *name;
+		bundle.libraries[i].name = *name;
+		if (!ShaderLibrary::parse(bytes.subspan(entry.byteOffset, entry.byteSize), bundle.libraries[i], flags)) {
+			std::cerr << "Failed to read library \"" << *name << "\" from shader bundle: " << path << std::endl;
+			return {};
+		}
+	}
+
+	return bundle;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 
@@ -27,13 +28,35 @@ T getEnumForJsonString(simdjson::simdjson_result<simdjson::dom::element> string,
 	return ret.value();
 }
 
+// The target is either a single language or an array of them, which are combined into one mask.
+shaders::ShaderLang getTargetsForJson(simdjson::simdjson_result<simdjson::dom::element> target) {
+	if (!target.is_array()) {
+		return getEnumForJsonString<shaders::ShaderLang>(target, "target");
+	}
+
+	auto targets = static_cast<shaders::ShaderLang>(0);
+	for (auto element : target.get_array().value()) {
+		std::string_view name;
+		auto lang = element.get(name) == 0 ? magic_enum::enum_cast<shaders::ShaderLang>(name) : std::nullopt;
+		if (!lang.has_value()) {
+			return static_cast<shaders::ShaderLang>(0);
+		}
+		targets = targets | *lang;
+	}
+	return targets;
+}
+
 std::int32_t shaders::parseJson(fs::path& path, shaders::ShaderJson& shader) {
+	simdjson::dom::parser parser;
+	return parseJson(path, shader, parser);
+}
+
+std::int32_t shaders::parseJson(fs::path& path, shaders::ShaderJson& shader, simdjson::dom::parser& parser) {
 	if (!fs::exists(path)) {
 		std::cerr << "JSON file does not exist: " << path << std::endl;
 		return -1;
 	}
 
-	simdjson::dom::parser parser;
 	auto doc = parser.load(path.string());
 
 	std::string_view nameView;
@@ -65,9 +88,11 @@ std::int32_t shaders::parseJson(fs::path& path, shaders::ShaderJson& shader) {
 		auto target = element["target"];
 		auto lang = element["lang"];
 		auto shaderName = element["name"];
+		auto group = element["group"];
+		auto spirvVersions = element["spirvVersions"];
 
 		if ((source.error() != 0 || target.error() != 0 || lang.error() != 0)
-		    && (!source.is_string() || !target.is_string() || !lang.is_string())) {
+		    && (!source.is_string() || !(target.is_string() || target.is_array()) || !lang.is_string())) {
 			std::cerr << "Missing or invalid stage, source, target, or lang fields for stage. Skipping stage." << std::endl;
 			continue;
 		}
@@ -113,14 +138,34 @@ std::int32_t shaders::parseJson(fs::path& path, shaders::ShaderJson& shader) {
 			continue;
 		}
 
-		auto stageTarget = getEnumForJsonString<ShaderLang>(target, "target");
+		auto stageTarget = getTargetsForJson(target);
 		auto stageLang = getEnumForJsonString<ShaderLang>(lang, "lang");
-
-		if (std::popcount(static_cast<std::underlying_type_t<decltype(stageTarget)>>(stageTarget)) > 1) {
-			std::cerr << "Only one target output is currently supported." << std::endl;
+		if (stageTarget == static_cast<ShaderLang>(0)) {
+			std::cerr << "Invalid target for stage: " << source.get_string().value() << std::endl;
 			continue;
 		}
 
+		// Every SPIR-V target is compiled once for each of these versions, all from a single parse of the source.
+		std::vector<SPVVersion> spirvVersionValues;
+		if (spirvVersions.is_array()) {
+			for (auto version : spirvVersions.get_array().value()) {
+				auto value = version.is_string() ? magic_enum::enum_cast<SPVVersion>(version.get_string().value()) : std::nullopt;
+				if (!value.has_value()) {
+					std::cerr << "Invalid SPIR-V version for stage: " << source.get_string().value() << std::endl;
+					spirvVersionValues.clear();
+					break;
+				}
+				spirvVersionValues.emplace_back(*value);
+			}
+			if (spirvVersionValues.empty()) {
+				continue;
+			}
+			std::sort(spirvVersionValues.begin(), spirvVersionValues.end());
+			spirvVersionValues.erase(std::unique(spirvVersionValues.begin(), spirvVersionValues.end()), spirvVersionValues.end());
+		} else {
+			spirvVersionValues.emplace_back(SPVVersion::SPV_1_3);
+		}
+
 		std::string_view shaderNameView;
 		if (shaderName.error() == 0 && shaderName.is_string()) {
 			shaderNameView = shaderName.get_string();
@@ -136,8 +181,56 @@ std::int32_t shaders::parseJson(fs::path& path, shaders::ShaderJson& shader) {
 			.target = stageTarget,
 			.name = std::string(shaderNameView),
 			.entryPoints = std::move(entryPointObjects),
+			.group = group.is_string() ? std::string { group.get_string().value() } : std::string {},
+			.spirvVersions = std::move(spirvVersionValues),
 		});
 	}
 
 	return 0;
 }
+
+std::int32_t shaders::parseManifest(const fs::path& path, shaders::ShaderManifest& manifest, simdjson::dom::parser& parser) {
+	if (!fs::exists(path)) {
+		std::cerr << "Manifest file does not exist: " << path << std::endl;
+		return -1;
+	}
+
+	auto doc = parser.load(path.string());
+
+	simdjson::dom::array librariesArray;
+	{
+		auto error = doc["libraries"].get_array().get(librariesArray);
+		if (error != 0) {
+			std::cerr << "Failed to get libraries array from manifest: " << simdjson::error_message(error) << std::endl;
+			return -1;
+		}
+	}
+
+	// All paths are relative to the manifest itself.
+	auto folder = path.parent_path();
+	manifest.entries.reserve(librariesArray.size());
+	for (auto element : librariesArray) {
+		std::string_view jsonView;
+		if (element["json"].get_string().get(jsonView) != 0) {
+			std::cerr << "Missing or invalid json field for manifest entry. Skipping entry." << std::endl;
+			continue;
+		}
+
+		std::string_view outputView;
+		if (auto output = element["output"]; output.error() == 0 && output.is_string()) {
+			outputView = output.get_string();
+		}
+
+		manifest.entries.emplace_back(ShaderManifestEntry {
+			.json = folder / fs::path(jsonView),
+			.outputName = std::string(outputView),
+		});
+	}
+
+	std::string_view stampView;
+	if (doc["stamp"].get_string().get(stampView) == 0) {
+		manifest.stamp = folder / fs::path(stampView);
+	}
+
+	return 0;
+}
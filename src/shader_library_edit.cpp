@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+
+#include <magic_enum.hpp>
+
+#include <shaders/file_io.hpp>
+#include <shaders/shader_library_edit.hpp>
+#include <shaders/shader_patch.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	[[nodiscard]] std::string getBinaryName(const shaders::ShaderBinary& binary) {
+		std::string name { binary.shaderName };
+		name += ':';
+		name += binary.name;
+		return name;
+	}
+
+	// An entry point can be stored for several targets, which are only unique together with the target.
+	[[nodiscard]] std::string getBinaryKey(const shaders::ShaderBinary& binary) {
+		return getBinaryName(binary) + '@' + shaders::getShaderTargetName(binary);
+	}
+
+	[[nodiscard]] std::optional<shaders::ShaderLibrary> readLibrary(const fs::path& path) {
+		auto library = shaders::readShaderLibraryFromFile(path);
+		if (library.getShaderBinaries().empty()) {
+			std::cerr << "Failed to read shader library: " << path << std::endl;
+			return std::nullopt;
+		}
+		return library;
+	}
+
+	// Parses a comma separated list of stages, using the same names as the JSON files.
+	[[nodiscard]] bool parseStageMask(std::string_view value, std::underlying_type_t<shaders::ShaderStage>& mask) {
+		for (std::size_t begin = 0; begin <= value.size();) {
+			auto end = std::min(value.find(',', begin), value.size());
+			std::string stageString { value.substr(begin, end - begin) };
+			begin = end + 1;
+			if (stageString.empty()) {
+				continue;
+			}
+
+			stageString[0] = static_cast<char>(std::toupper(stageString[0]));
+			auto stage = magic_enum::enum_cast<shaders::ShaderStage>(stageString);
+			if (!stage.has_value()) {
+				std::cerr << "Invalid shader stage: " << stageString << std::endl;
+				return false;
+			}
+			mask |= static_cast<std::underlying_type_t<shaders::ShaderStage>>(*stage);
+		}
+		return true;
+	}
+
+	[[nodiscard]] bool readKeepList(const fs::path& path, std::vector<std::string>& patterns) {
+		std::ifstream file(path);
+		if (!file) {
+			std::cerr << "Keep list does not exist: " << path << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if (!line.empty() && line.front() != '#') {
+				patterns.emplace_back(std::move(line));
+			}
+		}
+		return true;
+	}
+
+	[[nodiscard]] std::vector<std::byte> buildFromBinaries(std::span<const shaders::ShaderBinary* const> binaries) {
+		if (binaries.empty()) {
+			return {};
+		}
+
+		std::vector<shaders::ShaderInput> inputs;
+		inputs.reserve(binaries.size());
+		for (const auto* binary : binaries) {
+			inputs.emplace_back(shaders::copyShaderInput(*binary));
+		}
+		return shaders::buildShaderLibrary(std::move(inputs));
+	}
+} // namespace
+
+std::string shaders::getShaderTargetName(const ShaderBinary& binary) {
+	std::string target { binary.lang == ShaderLang::SPIRV ? magic_enum::enum_name(binary.spirvVersion)
+	                                                      : magic_enum::enum_name(binary.lang) };
+	std::transform(target.begin(), target.end(), target.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return target;
+}
+
+bool shaders::matchesGlobPattern(std::string_view string, std::string_view pattern) {
+	// Backtracks to the last star on a mismatch, which is linear for patterns with a single star.
+	std::size_t s = 0;
+	std::size_t p = 0;
+	auto starPattern = std::string_view::npos;
+	std::size_t starString = 0;
+	while (s < string.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == string[s])) {
+			++s;
+			++p;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			starPattern = p++;
+			starString = s;
+		} else if (starPattern != std::string_view::npos) {
+			p = starPattern + 1;
+			s = ++starString;
+		} else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
+bool shaders::matchesShaderLibraryFilter(const ShaderBinary& binary, const ShaderLibraryFilter& filter) {
+	if (filter.stageMask != 0 && (filter.stageMask & static_cast<std::underlying_type_t<ShaderStage>>(binary.stage)) == 0) {
+		return false;
+	}
+
+	// Patterns without a target match every target of an entry point.
+	auto name = getBinaryName(binary);
+	auto key = getBinaryKey(binary);
+	auto matches = [&name, &key](const std::string& pattern) {
+		return matchesGlobPattern(name, pattern) || matchesGlobPattern(key, pattern);
+	};
+	if (!filter.includePatterns.empty() && std::none_of(filter.includePatterns.begin(), filter.includePatterns.end(), matches)) {
+		return false;
+	}
+	return std::none_of(filter.excludePatterns.begin(), filter.excludePatterns.end(), matches);
+}
+
+shaders::ShaderInput shaders::copyShaderInput(const ShaderBinary& binary) {
+	const auto& reflection = binary.reflection;
+	return ShaderInput {
+		.shaderBytes = { binary.bytes.begin(), binary.bytes.end() },
+		.shaderName = std::string { binary.shaderName },
+		.name = std::string { binary.name },
+		.stage = binary.stage,
+		.lang = binary.lang,
+		.spirvVersion = binary.spirvVersion,
+		.reflection = {
+			.workgroupSize = reflection.workgroupSize,
+			.descriptorBindings = { reflection.descriptorBindings.begin(), reflection.descriptorBindings.end() },
+			.pushConstantRanges = { reflection.pushConstantRanges.begin(), reflection.pushConstantRanges.end() },
+			.vertexInputs = { reflection.vertexInputs.begin(), reflection.vertexInputs.end() },
+		},
+		.codec = binary.codec,
+		.group = std::string { binary.group },
+	};
+}
+
+std::vector<std::byte> shaders::filterShaderLibrary(const ShaderLibrary& library, const ShaderLibraryFilter& filter) {
+	std::vector<const ShaderBinary*> binaries;
+	for (const auto& binary : library.getShaderBinaries()) {
+		if (matchesShaderLibraryFilter(binary, filter)) {
+			binaries.emplace_back(&binary);
+		}
+	}
+	return buildFromBinaries(binaries);
+}
+
+std::vector<std::byte> shaders::mergeShaderLibraries(std::span<const ShaderLibrary* const> libraries) {
+	std::vector<const ShaderBinary*> binaries;
+	std::map<std::string, const ShaderBinary*> binariesByKey;
+	for (const auto* library : libraries) {
+		for (const auto& binary : library->getShaderBinaries()) {
+			auto [it, inserted] = binariesByKey.try_emplace(getBinaryKey(binary), &binary);
+			if (inserted) {
+				binaries.emplace_back(&binary);
+			} else if (it->second->hash != binary.hash || it->second->stage != binary.stage) {
+				std::cerr << "Conflicting binaries for " << it->first << " in merged libraries." << std::endl;
+				return {};
+			}
+		}
+	}
+	return buildFromBinaries(binaries);
+}
+
+std::int32_t shaders::runMergeCommand(std::span<char*> args) {
+	fs::path outputPath;
+	std::vector<fs::path> libraryPaths;
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--output") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			outputPath = *(++it);
+		} else {
+			libraryPaths.emplace_back(arg);
+		}
+	}
+
+	if (outputPath.empty() || libraryPaths.empty()) {
+		std::cerr << "Usage: shaderprocessor merge --output <library> <library>..." << std::endl;
+		return -1;
+	}
+
+	std::vector<ShaderLibrary> libraries;
+	std::vector<const ShaderLibrary*> libraryPointers;
+	libraries.reserve(libraryPaths.size());
+	for (const auto& path : libraryPaths) {
+		auto library = readLibrary(path);
+		if (!library.has_value()) {
+			return -1;
+		}
+		libraryPointers.emplace_back(&libraries.emplace_back(std::move(*library)));
+	}
+
+	auto bytes = mergeShaderLibraries(libraryPointers);
+	if (bytes.empty()) {
+		return -1;
+	}
+
+	AsyncFileWriter writer;
+	writer.write(outputPath, std::move(bytes));
+	return writer.wait() ? 0 : -1;
+}
+
+std::int32_t shaders::runFilterCommand(std::span<char*> args) {
+	fs::path libraryPath;
+	fs::path outputPath;
+	ShaderLibraryFilter filter;
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--output" || arg == "--stages" || arg == "--include" || arg == "--exclude" || arg == "--keep-list") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			std::string_view value = *(++it);
+
+			if (arg == "--output") {
+				outputPath = value;
+			} else if (arg == "--stages") {
+				if (!parseStageMask(value, filter.stageMask)) {
+					return -1;
+				}
+			} else if (arg == "--include") {
+				filter.includePatterns.emplace_back(value);
+			} else if (arg == "--exclude") {
+				filter.excludePatterns.emplace_back(value);
+			} else if (!readKeepList(value, filter.includePatterns)) {
+				return -1;
+			}
+		} else {
+			libraryPath = arg;
+		}
+	}
+
+	if (libraryPath.empty() || outputPath.empty()) {
+		std::cerr << "Usage: shaderprocessor filter <library> --output <library> [--stages <stage,...>] [--include <pattern>]"
+		             " [--exclude <pattern>] [--keep-list <file>]"
+		          << std::endl;
+		return -1;
+	}
+
+	auto library = readLibrary(libraryPath);
+	if (!library.has_value()) {
+		return -1;
+	}
+
+	auto bytes = filterShaderLibrary(*library, filter);
+	if (bytes.empty()) {
+		std::cerr << "No shaders of " << libraryPath << " match the filter." << std::endl;
+		return -1;
+	}
+
+	AsyncFileWriter writer;
+	writer.write(outputPath, std::move(bytes));
+	return writer.wait() ? 0 : -1;
+}
+
+std::int32_t shaders::runSplitCommand(std::span<char*> args) {
+	fs::path libraryPath;
+	fs::path outputDirectory = ".";
+	bool byStage = false;
+	// The parts in the order they were first given, as binaries are assigned to the first part they match.
+	std::vector<std::pair<std::string, ShaderLibraryFilter>> parts;
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--by-stage") {
+			byStage = true;
+		} else if (arg == "--output-dir" || arg == "--part") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			std::string_view value = *(++it);
+
+			if (arg == "--output-dir") {
+				outputDirectory = value;
+				continue;
+			}
+
+			auto separator = value.find('=');
+			if (separator == 0 || separator == std::string_view::npos) {
+				std::cerr << "Invalid part, expected <name>=<pattern>: " << value << std::endl;
+				return -1;
+			}
+			auto name = value.substr(0, separator);
+			auto part = std::find_if(parts.begin(), parts.end(), [name](const auto& part) { return part.first == name; });
+			if (part == parts.end()) {
+				part = parts.insert(parts.end(), { std::string { name }, ShaderLibraryFilter {} });
+			}
+			part->second.includePatterns.emplace_back(value.substr(separator + 1));
+		} else {
+			libraryPath = arg;
+		}
+	}
+
+	if (libraryPath.empty() || byStage == !parts.empty()) {
+		std::cerr << "Usage: shaderprocessor split <library> [--output-dir <dir>] (--by-stage | --part <name>=<pattern>...)" << std::endl;
+		return -1;
+	}
+
+	auto library = readLibrary(libraryPath);
+	if (!library.has_value()) {
+		return -1;
+	}
+
+	if (byStage) {
+		for (const auto& binary : library->getShaderBinaries()) {
+			std::string name { magic_enum::enum_name(binary.stage) };
+			std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+			if (std::none_of(parts.begin(), parts.end(), [&name](const auto& part) { return part.first == name; })) {
+				parts.emplace_back(std::move(name),
+				                   ShaderLibraryFilter { .stageMask = static_cast<std::underlying_type_t<ShaderStage>>(binary.stage) });
+			}
+		}
+	}
+
+	std::vector<std::vector<const ShaderBinary*>> partBinaries(parts.size() + 1);
+	for (const auto& binary : library->getShaderBinaries()) {
+		auto part = std::find_if(parts.begin(), parts.end(), [&binary](const auto& part) {
+			return matchesShaderLibraryFilter(binary, part.second);
+		});
+		partBinaries[static_cast<std::size_t>(part - parts.begin())].emplace_back(&binary);
+	}
+
+	std::error_code error;
+	fs::create_directories(outputDirectory, error);
+	AsyncFileWriter writer;
+	auto stem = libraryPath.stem().string();
+	for (std::size_t i = 0; i < partBinaries.size(); ++i) {
+		if (partBinaries[i].empty()) {
+			continue;
+		}
+
+		auto name = i < parts.size() ? parts[i].first : std::string { "other" };
+		auto outputPath = outputDirectory / (stem + '_' + name + ".shader");
+		std::cout << ">> " << outputPath.filename() << ": " << partBinaries[i].size() << " shaders" << std::endl;
+		writer.write(std::move(outputPath), buildFromBinaries(partBinaries[i]));
+	}
+	return writer.wait() ? 0 : -1;
+}
+
+std::int32_t shaders::runDiffCommand(std::span<char*> args) {
+	fs::path outputPath;
+	std::vector<fs::path> libraryPaths;
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--output") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			outputPath = *(++it);
+		} else {
+			libraryPaths.emplace_back(arg);
+		}
+	}
+
+	if (outputPath.empty() || libraryPaths.size() != 2) {
+		std::cerr << "Usage: shaderprocessor diff <old library> <new library> --output <patch>" << std::endl;
+		return -1;
+	}
+
+	auto oldBytes = readFileAsBytes(libraryPaths[0]);
+	auto newBytes = readFileAsBytes(libraryPaths[1]);
+	auto patch = createShaderLibraryPatch(oldBytes, newBytes);
+	if (patch.empty()) {
+		std::cerr << "Failed to create a patch from " << libraryPaths[0] << " to " << libraryPaths[1] << std::endl;
+		return -1;
+	}
+
+	std::cout << ">> " << outputPath.filename() << ": " << patch.size() << " bytes for a library of " << newBytes.size() << " bytes"
+	          << std::endl;
+	AsyncFileWriter writer;
+	writer.write(outputPath, std::move(patch));
+	return writer.wait() ? 0 : -1;
+}
+
+std::int32_t shaders::runPatchCommand(std::span<char*> args) {
+	fs::path outputPath;
+	std::vector<fs::path> paths;
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--output") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			outputPath = *(++it);
+		} else {
+			paths.emplace_back(arg);
+		}
+	}
+
+	if (paths.size() != 2) {
+		std::cerr << "Usage: shaderprocessor patch <library> <patch> [--output <library>]" << std::endl;
+		return -1;
+	}
+	if (outputPath.empty()) {
+		outputPath = paths[0];
+	}
+
+	auto library = readFileAsBytes(paths[0]);
+	auto patch = readFileAsBytes(paths[1]);
+	if (!applyShaderLibraryPatch(library, patch)) {
+		std::cerr << "Failed to apply " << paths[1] << " to " << paths[0] << std::endl;
+		return -1;
+	}
+
+	AsyncFileWriter writer;
+	writer.write(outputPath, std::move(library));
+	return writer.wait() ? 0 : -1;
+}
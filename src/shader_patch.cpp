@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#include <shaders/shader_patch.hpp>
+
+namespace ks = ::shaders;
+
+static_assert(std::has_unique_object_representations_v<ks::ShaderPatchHeader>, "ShaderPatchHeader must not contain padding");
+
+namespace {
+	// Matches are searched for at word granularity, as adding or removing SPIR-V instructions shifts the
+	// following code by whole words.
+	constexpr std::size_t blockSize = 16;
+	constexpr std::size_t blockAlignment = sizeof(std::uint32_t);
+
+	[[nodiscard]] std::uint64_t loadBlock(std::span<const std::byte> bytes, std::size_t offset) {
+		std::uint64_t low = 0;
+		std::uint64_t high = 0;
+		std::memcpy(&low, bytes.data() + offset, sizeof low);
+		std::memcpy(&high, bytes.data() + offset + sizeof low, sizeof high);
+		return (low * 0x9E3779B97F4A7C15ULL) ^ high;
+	}
+
+	void writeVarint(std::vector<std::byte>& output, std::uint64_t value) {
+		while (value >= 0x80) {
+			output.emplace_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		output.emplace_back(static_cast<std::byte>(value));
+	}
+
+	[[nodiscard]] std::optional<std::uint64_t> readVarint(std::span<const std::byte> bytes, std::size_t& position) {
+		std::uint64_t value = 0;
+		for (std::uint32_t shift = 0; shift < 64 && position < bytes.size(); shift += 7) {
+			auto byte = static_cast<std::uint64_t>(bytes[position++]);
+			value |= (byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		return std::nullopt;
+	}
+
+	// Emits the operations for the new library from front to back, collecting bytes without a match into adds.
+	class PatchEncoder {
+		std::span<const std::byte> oldBytes;
+		std::span<const std::byte> newBytes;
+		std::vector<std::byte>& patch;
+		// The first offset of every block of the old library, keyed by a hash of its contents.
+		std::unordered_map<std::uint64_t, std::size_t> blocks;
+		std::size_t literalBegin = 0;
+		std::size_t lastCopyEnd = 0;
+
+		void flushLiteral(std::size_t end) {
+			if (end > literalBegin) {
+				writeVarint(patch, (end - literalBegin) << 1);
+				patch.insert(patch.end(), newBytes.begin() + static_cast<std::ptrdiff_t>(literalBegin),
+				             newBytes.begin() + static_cast<std::ptrdiff_t>(end));
+			}
+			literalBegin = end;
+		}
+
+	public:
+		PatchEncoder(std::span<const std::byte> oldBytes, std::span<const std::byte> newBytes, std::vector<std::byte>& patch)
+			: oldBytes(oldBytes), newBytes(newBytes), patch(patch) {
+			for (std::size_t offset = 0; offset + blockSize <= oldBytes.size(); offset += blockAlignment) {
+				blocks.try_emplace(loadBlock(oldBytes, offset), offset);
+			}
+		}
+
+		void copy(std::size_t oldOffset, std::size_t length, std::size_t newOffset) {
+			flushLiteral(newOffset);
+			auto delta = static_cast<std::int64_t>(oldOffset) - static_cast<std::int64_t>(lastCopyEnd);
+			writeVarint(patch, (static_cast<std::uint64_t>(length) << 1) | 1);
+			writeVarint(patch, (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63));
+			lastCopyEnd = oldOffset + length;
+			literalBegin = newOffset + length;
+		}
+
+		void encode(std::size_t begin, std::size_t end) {
+			auto position = begin;
+			while (position + blockSize <= end) {
+				auto it = blocks.find(loadBlock(newBytes, position));
+				if (it == blocks.end() || std::memcmp(oldBytes.data() + it->second, newBytes.data() + position, blockSize) != 0) {
+					position += blockAlignment;
+					continue;
+				}
+
+				auto length = blockSize;
+				while (position + length < end && it->second + length < oldBytes.size()
+				       && oldBytes[it->second + length] == newBytes[position + length]) {
+					++length;
+				}
+				copy(it->second, length, position);
+				position += length;
+			}
+		}
+
+		void finish() {
+			flushLiteral(newBytes.size());
+		}
+	};
+} // namespace
+
+std::vector<std::byte> ks::createShaderLibraryPatch(std::span<const std::byte> oldLibrary, std::span<const std::byte> newLibrary) {
+	auto oldShaders = readShaderLibraryFromMemory(oldLibrary);
+	auto newShaders = readShaderLibraryFromMemory(newLibrary);
+	if (oldShaders.getShaderBinaries().empty() || newShaders.getShaderBinaries().empty()) {
+		return {};
+	}
+
+	// An entry point can be stored for several targets, so binaries are matched like ReloadableShaderLibrary does.
+	using BinaryKey = std::tuple<std::string_view, std::string_view, ShaderLang, SPVVersion>;
+	std::map<BinaryKey, const ShaderBinary*> oldBinaries;
+	for (const auto& binary : oldShaders.getShaderBinaries()) {
+		if (binary.codec == ShaderCodec::None) {
+			oldBinaries.emplace(BinaryKey { binary.shaderName, binary.name, binary.lang, binary.spirvVersion }, &binary);
+		}
+	}
+
+	// The binaries are visited in the order they are stored in, so that the operations only move forward. Binaries
+	// stored with a codec are decoded into memory owned by the library, so their encoded bytes are only matched
+	// as part of the surrounding data.
+	std::vector<const ShaderBinary*> newBinaries;
+	for (const auto& binary : newShaders.getShaderBinaries()) {
+		if (binary.codec == ShaderCodec::None) {
+			newBinaries.emplace_back(&binary);
+		}
+	}
+	std::sort(newBinaries.begin(), newBinaries.end(), [](const ShaderBinary* lhs, const ShaderBinary* rhs) {
+		return lhs->bytes.data() < rhs->bytes.data();
+	});
+
+	std::vector<std::byte> patch(sizeof(ShaderPatchHeader));
+	ShaderPatchHeader header = {
+		.magic = patchHeaderMagic,
+		.version = headerVersion,
+		.reserved = 0,
+		.baseHash = hashContent(oldLibrary),
+		.resultHash = hashContent(newLibrary),
+		.resultSize = newLibrary.size(),
+	};
+	std::memcpy(patch.data(), &header, sizeof header);
+
+	PatchEncoder encoder(oldLibrary, newLibrary, patch);
+	std::size_t position = 0;
+	for (const auto* binary : newBinaries) {
+		auto offset = static_cast<std::size_t>(binary->bytes.data() - newLibrary.data());
+		encoder.encode(position, offset);
+		position = offset + binary->bytes.size();
+
+		// Unchanged binaries are copied as a whole without searching for matches.
+		auto old = oldBinaries.find(BinaryKey { binary->shaderName, binary->name, binary->lang, binary->spirvVersion });
+		if (old != oldBinaries.end() && old->second->hash == binary->hash && old->second->bytes.size() == binary->bytes.size()) {
+			encoder.copy(static_cast<std::size_t>(old->second->bytes.data() - oldLibrary.data()), binary->bytes.size(), offset);
+		} else {
+			encoder.encode(offset, position);
+		}
+	}
+	encoder.encode(position, newLibrary.size());
+	encoder.finish();
+	return patch;
+}
+
+bool ks::applyShaderLibraryPatch(std::vector<std::byte>& library, std::span<const std::byte> patch) {
+	if (patch.size() < sizeof(ShaderPatchHeader)) {
+		std::cerr << "Shader patch too small: " << patch.size() << " bytes" << std::endl;
+		return false;
+	}
+
+	ShaderPatchHeader header = {};
+	std::memcpy(&header, patch.data(), sizeof header);
+	if (header.magic != patchHeaderMagic || header.version != headerVersion) {
+		std::cerr << "Invalid magic or unsupported version of shader patch" << std::endl;
+		return false;
+	}
+
+	if (hashContent(library) != header.baseHash) {
+		std::cerr << "Shader patch was created for a different library" << std::endl;
+		return false;
+	}
+
+	std::vector<std::byte> result;
+	result.reserve(header.resultSize);
+	std::size_t position = sizeof(ShaderPatchHeader);
+	std::uint64_t lastCopyEnd = 0;
+	while (position < patch.size()) {
+		auto operation = readVarint(patch, position);
+		if (!operation.has_value() || (*operation >> 1) > header.resultSize - result.size()) {
+			std::cerr << "Malformed shader patch operation" << std::endl;
+			return false;
+		}
+
+		auto length = static_cast<std::size_t>(*operation >> 1);
+		if ((*operation & 1) == 0) {
+			if (length > patch.size() - position) {
+				std::cerr << "Malformed shader patch operation" << std::endl;
+				return false;
+			}
+			result.insert(result.end(), patch.begin() + static_cast<std::ptrdiff_t>(position),
+			              patch.begin() + static_cast<std::ptrdiff_t>(position + length));
+			position += length;
+			continue;
+		}
+
+		auto zigzag = readVarint(patch, position);
+		if (!zigzag.has_value()) {
+			std::cerr << "Malformed shader patch operation" << std::endl;
+			return false;
+		}
+		auto delta = static_cast<std::int64_t>(*zigzag >> 1) ^ -static_cast<std::int64_t>(*zigzag & 1);
+		auto offset = lastCopyEnd + static_cast<std::uint64_t>(delta);
+		if (offset > library.size() || length > library.size() - offset) {
+			std::cerr << "Shader patch copies outside of the library" << std::endl;
+			return false;
+		}
+		result.insert(result.end(), library.begin() + static_cast<std::ptrdiff_t>(offset),
+		              library.begin() + static_cast<std::ptrdiff_t>(offset + length));
+		lastCopyEnd = offset + length;
+	}
+
+	if (result.size() != header.resultSize || hashContent(result) != header.resultHash) {
+		std::cerr << "Patched shader library does not match the expected content hash" << std::endl;
+		return false;
+	}
+	library = std::move(result);
+	return true;
+}
@@ -1,161 +1,769 @@
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
 #include <sstream>
 #include <span>
+#include <thread>
+#include <unordered_map>
 
-#ifdef WITH_SLANG_SHADERS
-#include <slang.h>
-#endif
+#include <magic_enum.hpp>
 
-#ifdef WITH_GLSLANG_SHADERS
-#include <glslang/Public/ShaderLang.h>
+#ifndef SIMDJSON_EXCEPTIONS
+#define SIMDJSON_EXCEPTIONS 1
 #endif
 
-#ifdef WITH_SPIRV_CROSS
-#include <spirv_cross_c.h>
-#endif
+#include <simdjson.h>
 
 #include <shaders/compile.hpp>
+#include <shaders/compile_schedule.hpp>
+#include <shaders/input_manifest.hpp>
+#include <shaders/remote_compile.hpp>
 #include <shaders/shader_binary.hpp>
 #include <shaders/shader_json.hpp>
+#include <shaders/shader_library_edit.hpp>
+#include <shaders/shader_report.hpp>
 #include <shaders/shader_constants.hpp>
 
 namespace fs = std::filesystem;
 
-std::string shaders::readFileAsString(const fs::path& path) {
-	std::ifstream fileInput(path);
-	std::stringstream fileContents;
-	fileContents << fileInput.rdbuf();
-	return fileContents.str();
+struct ProcessorOptions {
+	// When not empty, all libraries are packed into a single bundle file instead of writing one file per library.
+	std::string bundleName;
+	// When not empty, compile jobs are sent to these workers instead of being executed locally.
+	std::vector<std::string> workerAddresses;
+	// Writes every library as a C++ header that embeds its bytes, instead of a .shader file.
+	bool embed = false;
+	// Additionally writes a header with the index of every shader for each library.
+	bool idHeader = false;
+	// Stores SPIR-V binaries with the compact encoding, see spirv_codec.hpp.
+	bool compactSpirv = false;
+	// Puts every shader without a group from its JSON into a group named after its stage.
+	bool groupByStage = false;
+	// When not empty, the shaders are stored in the order they were first used in this trace.
+	fs::path accessTracePath;
+	// Compiles in threadCount forked processes instead of threads, so that compilers which are not threadsafe run in
+	// parallel, and a crashing compiler only takes down a single process.
+	bool processPool = false;
+	// The amount of threads compiling jobs locally.
+	std::uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1U);
+	// When running under make with a jobserver, threads beyond the first only run while holding one of its tokens.
+	std::optional<shaders::JobServerClient> jobServer;
+	// When not empty, the compile durations are recorded in this file, which is used to start the longest jobs first.
+	fs::path timingsPath;
+	// Rebuilds every library, even if its input manifest shows that nothing changed.
+	bool force = false;
+	// The processor itself is an input of every library, so that they are rebuilt when it changes.
+	fs::path executablePath;
+};
+
+// A library whose JSON has been parsed and whose compile jobs have been queued, but not yet built.
+struct PendingLibrary {
+	fs::path jsonPath;
+	// The name of the output file, which defaults to the name in the JSON.
+	std::string outputName;
+	shaders::ShaderJson json;
+	// The inputs are collected per description, so that the library always uses the declaration order
+	// regardless of where and in which order the jobs are executed.
+	std::vector<std::vector<shaders::ShaderInput>> descriptionInputs;
+	// The options the outputs were built with, and the files they were built from and written to.
+	std::string outputOptions;
+	fs::path manifestPath;
+	// The stat data of every input from before the compile jobs ran, and for the JSON and the sources from before they
+	// were read, so that changes made while the library is built are noticed.
+	std::map<fs::path, std::optional<shaders::FileStat>> inputStats;
+	std::vector<fs::path> outputPaths;
+	// Libraries with inputs that are not known here, like the modules imported by Slang shaders, get no manifest.
+	bool tracksInputs = true;
+};
+
+// Identifies the description a queued compile job was created from.
+struct JobOrigin {
+	std::size_t library;
+	std::size_t description;
+};
+
+// The manifest is named after the absolute path of the JSON, as JSONs in different folders can have the same name.
+fs::path getInputManifestPath(const fs::path& outputFolder, const fs::path& jsonPath) {
+	auto absolutePath = fs::absolute(jsonPath).lexically_normal().string();
+	auto hash = shaders::hashContent(std::as_bytes(std::span { absolutePath }));
+	std::ostringstream name;
+	name << jsonPath.stem().string() << '.' << std::hex << std::setw(16) << std::setfill('0') << hash.low << ".inputs";
+	return outputFolder / name.str();
 }
 
-std::vector<std::byte> shaders::readFileAsBytes(const fs::path& path) {
-	std::ifstream fileInput(path, std::ios::binary);
-	fileInput.ignore(std::numeric_limits<std::streamsize>::max());
-	auto length = fileInput.gcount();
-	fileInput.clear();
-	fileInput.seekg(0, std::ifstream::beg);
+// Everything from the command line that changes the outputs of the library.
+std::string getOutputOptions(const ProcessorOptions& options, const PendingLibrary& library) {
+	std::ostringstream out;
+	out << "output=" << library.outputName << " bundle=" << options.bundleName << " embed=" << options.embed << " header=" << options.idHeader
+	    << " compact=" << options.compactSpirv << " groupByStage=" << options.groupByStage << " trace=" << options.accessTracePath.string();
+	return out.str();
+}
 
-	std::vector<std::byte> bytes(length);
-	fileInput.seekg(0);
-	fileInput.read(reinterpret_cast<char*>(bytes.data()), length);
-	return bytes;
+void addInputPath(PendingLibrary& library, const fs::path& path) {
+	auto absolutePath = fs::absolute(path).lexically_normal();
+	if (!library.inputStats.contains(absolutePath)) {
+		library.inputStats.emplace(absolutePath, shaders::getFileStat(absolutePath));
+	}
 }
 
-std::int32_t processJson(fs::path path) noexcept {
-	shaders::ShaderJson json;
-	auto error = shaders::parseJson(path, json);
+// Removes every library whose manifest shows that neither its inputs, its outputs nor the options changed, which
+// only takes a stat call per file. A bundle contains all libraries, so it is either skipped or rebuilt as a whole.
+void skipUnchangedLibraries(std::vector<PendingLibrary>& libraries, const ProcessorOptions& options) {
+	std::vector<bool> unchanged(libraries.size());
+	for (std::size_t i = 0; i < libraries.size(); ++i) {
+		auto& library = libraries[i];
+		auto manifest = shaders::readInputManifest(library.manifestPath);
+		bool updated = false;
+		unchanged[i] = manifest.has_value() && shaders::isInputManifestCurrent(*manifest, library.outputOptions, updated);
+		if (unchanged[i] && updated) {
+			// Store the new stat data, so that the same files are not hashed again on the next run.
+			static_cast<void>(shaders::writeInputManifest(library.manifestPath, *manifest));
+		}
+	}
+
+	if (!options.bundleName.empty() && std::find(unchanged.begin(), unchanged.end(), false) != unchanged.end()) {
+		return;
+	}
+
+	std::size_t index = 0;
+	std::erase_if(libraries, [&](const PendingLibrary& library) {
+		if (!unchanged[index++]) {
+			return false;
+		}
+		std::cout << "Skipping " << library.jsonPath.string() << ", nothing changed" << std::endl;
+		return true;
+	});
+}
+
+// Records the files the library was built from once all of its outputs have been written. Libraries without
+// a manifest are always rebuilt, which is also the case if any of the files was removed or changed in the meantime.
+void writeLibraryManifest(PendingLibrary& library, const ProcessorOptions& options) {
+	if (library.manifestPath.empty()) {
+		return;
+	}
+
+	std::optional<std::vector<shaders::FileRecord>> inputs;
+	std::optional<std::vector<shaders::FileRecord>> outputs;
+	if (library.tracksInputs && !options.executablePath.empty()) {
+		std::vector<fs::path> inputPaths;
+		inputPaths.reserve(library.inputStats.size());
+		for (const auto& [path, stat] : library.inputStats) {
+			inputPaths.emplace_back(path);
+		}
+
+		auto previous = shaders::readInputManifest(library.manifestPath);
+		inputs = shaders::recordInputFiles(inputPaths, previous.has_value() ? &*previous : nullptr);
+		outputs = shaders::recordOutputFiles(library.outputPaths);
+
+		// The records are taken now, so an input that changed after it was read would be recorded with contents the
+		// outputs were not built from. Such a library is rebuilt on the next run instead.
+		auto isChanged = [&library](const shaders::FileRecord& record) {
+			auto stat = library.inputStats.find(record.path);
+			return stat == library.inputStats.end() || stat->second != record.stat;
+		};
+		if (inputs.has_value() && std::any_of(inputs->begin(), inputs->end(), isChanged)) {
+			std::cout << "Inputs of " << library.jsonPath.string() << " changed while building, it will be rebuilt on the next run"
+			          << std::endl;
+			inputs.reset();
+		}
+	}
+
+	if (!inputs.has_value() || !outputs.has_value()) {
+		std::error_code error;
+		fs::remove(library.manifestPath, error);
+		return;
+	}
+
+	shaders::InputManifest manifest = {
+		.options = library.outputOptions,
+		.inputs = std::move(*inputs),
+		.outputs = std::move(*outputs),
+	};
+	if (!shaders::writeInputManifest(library.manifestPath, manifest)) {
+		std::cerr << "Failed to write input manifest: " << library.manifestPath << std::endl;
+	}
+}
+
+// Turns a library name into something that can be used as a C++ identifier.
+std::string getEmbeddedIdentifier(std::string_view name) {
+	std::string identifier;
+	identifier.reserve(name.size() + 1);
+	if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front())) != 0) {
+		identifier += '_';
+	}
+	for (auto c : name) {
+		identifier += std::isalnum(static_cast<unsigned char>(c)) != 0 ? c : '_';
+	}
+	return identifier;
+}
+
+// Generates a header that contains the library as a byte array, aligned so that it can be passed
+// to readShaderLibraryFromMemory without copying it.
+std::vector<std::byte> generateEmbeddedHeader(std::string_view name, std::span<const std::byte> bytes) {
+	auto identifier = getEmbeddedIdentifier(name);
+
+	std::ostringstream out;
+	out << "// Generated by shaderprocessor from the shader library \"" << name << "\". Do not edit.\n"
+	    << "#pragma once\n\n"
+	    << "#include <cstddef>\n"
+	    << "#include <span>\n\n"
+	    << "namespace shaders::embedded {\n"
+	    << "\tnamespace detail {\n"
+	    << "\t\talignas(" << shaders::shaderBinaryAlignment << ") inline constexpr unsigned char " << identifier << "[] = {";
+
+	constexpr std::string_view hexDigits = "0123456789abcdef";
+	for (std::size_t i = 0; i < bytes.size(); ++i) {
+		if (i % 16 == 0) {
+			out << "\n\t\t\t";
+		}
+		auto value = static_cast<std::uint8_t>(bytes[i]);
+		out << "0x" << hexDigits[value >> 4] << hexDigits[value & 0xF] << ',';
+	}
+
+	out << "\n\t\t};\n"
+	    << "\t} // namespace detail\n\n"
+	    << "\t// Pass this to shaders::readShaderLibraryFromMemory.\n"
+	    << "\t[[nodiscard]] inline std::span<const std::byte> " << identifier << "() {\n"
+	    << "\t\treturn std::as_bytes(std::span { detail::" << identifier << " });\n"
+	    << "\t}\n"
+	    << "} // namespace shaders::embedded\n";
+
+	auto contents = out.str();
+	auto contentBytes = std::as_bytes(std::span { contents });
+	return { contentBytes.begin(), contentBytes.end() };
+}
+
+// Generates a header with a constant for the index of every shader in the library, so that shaders can be looked up
+// with getShaderBinaryByIndex. Shaders with a single entry point are named after the shader, others get the entry
+// point name appended. Entry points stored for several targets additionally get the target appended, like spv_1_6 or msl.
+std::optional<std::vector<std::byte>> generateIdHeader(std::string_view name, std::span<const std::byte> libraryBytes) {
+	auto library = shaders::readShaderLibraryFromMemory(libraryBytes);
+	auto binaries = library.getShaderBinaries();
+
+	std::ostringstream out;
+	out << "// Generated by shaderprocessor from the shader library \"" << name << "\". Do not edit.\n"
+	    << "#pragma once\n\n"
+	    << "#include <cstddef>\n\n"
+	    << "#include <shaders/content_hash.hpp>\n\n"
+	    << "namespace shaders::ids::" << getEmbeddedIdentifier(name) << " {\n"
+	    << "\t// Compare this with ShaderLibrary::getLayoutHash after loading, to detect a library that was built differently.\n"
+	    << "\tinline constexpr ContentHash layoutHash = { " << std::hex << std::showbase << library.getLayoutHash().low << "ULL, "
+	    << library.getLayoutHash().high << "ULL };\n\n"
+	    << std::dec << std::noshowbase;
+
+	std::vector<std::string> identifiers;
+	for (std::size_t i = 0; i < binaries.size(); ++i) {
+		const auto& binary = binaries[i];
+		auto hasOtherEntryPoints = std::any_of(binaries.begin(), binaries.end(), [&](const shaders::ShaderBinary& other) {
+			return other.shaderName == binary.shaderName && other.name != binary.name;
+		});
+		auto targetCount = std::count_if(binaries.begin(), binaries.end(), [&](const shaders::ShaderBinary& other) {
+			return other.shaderName == binary.shaderName && other.name == binary.name;
+		});
+
+		std::string identifierName { binary.shaderName };
+		if (hasOtherEntryPoints) {
+			identifierName += '_';
+			identifierName += binary.name;
+		}
+		if (targetCount > 1) {
+			identifierName += '_';
+			identifierName += shaders::getShaderTargetName(binary);
+		}
+		auto identifier = getEmbeddedIdentifier(identifierName);
+		if (std::find(identifiers.begin(), identifiers.end(), identifier) != identifiers.end()) {
+			std::cerr << "Cannot generate IDs for \"" << name << "\", as multiple shaders map to the identifier " << identifier << std::endl;
+			return std::nullopt;
+		}
+
+		out << "\tinline constexpr std::size_t " << identifier << " = " << i << ";\n";
+		identifiers.emplace_back(std::move(identifier));
+	}
+	out << "} // namespace shaders::ids::" << getEmbeddedIdentifier(name) << "\n";
+
+	auto contents = out.str();
+	auto contentBytes = std::as_bytes(std::span { contents });
+	return std::vector<std::byte> { contentBytes.begin(), contentBytes.end() };
+}
+
+std::vector<shaders::CompileJobResult> executeCompileJobs(const ProcessorOptions& options, std::span<const shaders::CompileJob> jobs) {
+	auto timings = options.timingsPath.empty() ? shaders::CompileTimings {} : shaders::CompileTimings::readFromFile(options.timingsPath);
+	auto order = shaders::getCompileJobOrder(jobs, timings);
+
+#ifdef WITH_REMOTE_COMPILE
+	std::vector<std::optional<shaders::CompileJobResult>> remoteResults;
+	if (!options.workerAddresses.empty()) {
+		// Jobs that no worker could take are executed locally.
+		remoteResults = shaders::executeRemoteCompileJobs(options.workerAddresses, jobs, order);
+		std::erase_if(order, [&](std::size_t i) { return remoteResults[i].has_value(); });
+	}
+#endif
+
+	std::vector<std::chrono::microseconds> durations(jobs.size());
+#ifdef WITH_REMOTE_COMPILE
+	// Jobs that no worker process could take are executed locally too.
+	std::vector<std::optional<shaders::CompileJobResult>> processResults;
+	if (options.processPool) {
+		processResults = shaders::executeProcessCompileJobs(options.threadCount, jobs, order, durations, options.jobServer ? &*options.jobServer : nullptr);
+		std::erase_if(order, [&](std::size_t i) { return processResults[i].has_value(); });
+	}
+#endif
+
+	auto results = shaders::executeLocalCompileJobs(jobs, order, options.threadCount, durations, options.jobServer ? &*options.jobServer : nullptr);
+
+#ifdef WITH_REMOTE_COMPILE
+	for (auto* executedResults : { &remoteResults, &processResults }) {
+		for (std::size_t i = 0; i < executedResults->size(); ++i) {
+			if ((*executedResults)[i].has_value()) {
+				results[i] = std::move(*(*executedResults)[i]);
+			}
+		}
+	}
+#endif
+
+	// Only jobs executed on this machine have a duration, as the round trip to a worker says little about the compile time.
+	if (!options.timingsPath.empty()) {
+		for (std::size_t i = 0; i < jobs.size(); ++i) {
+			if (durations[i].count() > 0 && !results[i].empty()) {
+				timings.record(jobs[i], durations[i]);
+			}
+		}
+		timings.writeToFile(options.timingsPath);
+	}
+	return results;
+}
+
+// The targets that are generated from the source, which are all targets except for the source language itself.
+shaders::ShaderLang getGeneratedTargets(const shaders::ShaderJsonDesc& desc) {
+	using EnumType = std::underlying_type_t<shaders::ShaderLang>;
+	return static_cast<shaders::ShaderLang>(static_cast<EnumType>(desc.target) & ~static_cast<EnumType>(desc.lang));
+}
+
+bool hasTarget(shaders::ShaderLang targets, shaders::ShaderLang lang) {
+	return (targets & lang) == lang;
+}
+
+// MSL is translated from SPIR-V, so it only needs a compile job if the source is not SPIR-V already.
+bool needsCompileJob(const shaders::ShaderJsonDesc& desc) {
+	auto generated = getGeneratedTargets(desc);
+	return hasTarget(generated, shaders::ShaderLang::SPIRV) || (hasTarget(generated, shaders::ShaderLang::MSL) && desc.lang != shaders::ShaderLang::SPIRV);
+}
+
+bool canGenerateTargets(const shaders::ShaderJsonDesc& desc) {
+	auto generated = getGeneratedTargets(desc);
+	if ((generated | shaders::ShaderLang::SPIRV | shaders::ShaderLang::MSL) != (shaders::ShaderLang::SPIRV | shaders::ShaderLang::MSL)) {
+		return false;
+	}
+#ifndef WITH_SPIRV_CROSS
+	if (hasTarget(generated, shaders::ShaderLang::MSL)) {
+		return false;
+	}
+#endif
+	return !needsCompileJob(desc) || shaders::canCompileToSpirv(desc.lang);
+}
+
+// Reads the version from the header of a SPIR-V module. Versions outside of SPVVersion are not supported.
+std::optional<shaders::SPVVersion> getSpirvVersion(std::span<const std::byte> spirv) {
+	if (spirv.size() < 2 * sizeof(std::uint32_t)) {
+		return std::nullopt;
+	}
+	std::uint32_t version = 0;
+	std::memcpy(&version, spirv.data() + sizeof(std::uint32_t), sizeof(version));
+	auto major = (version >> 16) & 0xFF;
+	auto minor = (version >> 8) & 0xFF;
+	if (major != 1 || minor < 3 || minor > 6) {
+		return std::nullopt;
+	}
+	return static_cast<shaders::SPVVersion>(minor - 3);
+}
+
+#ifdef WITH_SPIRV_CROSS
+// Metal sources cannot be reflected, so MSL inputs take the reflection of the SPIR-V they were translated from.
+std::int32_t addMslInput(PendingLibrary& library, std::size_t descriptionIndex, std::span<const std::byte> spirv,
+                         const shaders::ShaderEntryPoint& entryPoint) {
+	const auto& desc = library.json.descriptions[descriptionIndex];
+	auto msl = shaders::generateMslFromSpv(spirv, entryPoint);
+	if (msl.empty()) {
+		std::cerr << ">> Failed to generate MSL: " << entryPoint.name << std::endl;
+		return -1;
+	}
+
+	auto mslBytes = std::as_bytes(std::span { msl });
+	library.descriptionInputs[descriptionIndex].emplace_back(shaders::ShaderInput {
+		.shaderBytes = { mslBytes.begin(), mslBytes.end() },
+		.shaderName = desc.name,
+		.name = entryPoint.name,
+		.stage = entryPoint.stage,
+		.lang = shaders::ShaderLang::MSL,
+		.reflection = shaders::reflectSpirv(spirv, entryPoint),
+		.group = desc.group,
+	});
+	return 0;
+}
+#endif
+
+// Parses the JSON and queues the sources of all of its descriptions that are either copied or compiled.
+std::int32_t queueJson(PendingLibrary& library, std::size_t libraryIndex, simdjson::dom::parser& parser, std::vector<JobOrigin>& sourceReads) {
+	auto& json = library.json;
+	addInputPath(library, library.jsonPath);
+	auto error = shaders::parseJson(library.jsonPath, json, parser);
 	if (error != 0) {
 		return error;
 	}
 
 	if (json.descriptions.empty()) {
-		std::cerr << "No shaders specified in file: " << path << std::endl;
+		std::cerr << "No shaders specified in file: " << library.jsonPath << std::endl;
 		return -1;
 	}
 
-	auto outputFolder = fs::current_path() / "shaders";
-	std::vector<shaders::ShaderInput> shaderInputs;
-	shaderInputs.reserve(json.descriptions.size());
-	for (auto& desc : json.descriptions) {
+	if (library.outputName.empty()) {
+		library.outputName = json.name;
+	}
+
+	library.descriptionInputs.resize(json.descriptions.size());
+	for (std::size_t i = 0; i < json.descriptions.size(); ++i) {
+		const auto& desc = json.descriptions[i];
 		std::cout << ">> " << desc.source.filename() << std::endl;
-		const auto& frontEntry = desc.entryPoints.front();
+		addInputPath(library, desc.source);
+		// Only the includes of GLSL are known, as it is preprocessed when creating the jobs.
+		if (needsCompileJob(desc) && desc.lang != shaders::ShaderLang::GLSL) {
+			library.tracksInputs = false;
+		}
 
-		// If the target is the same as the input, we'll just copy the data.
-		if (desc.target == desc.lang) {
-			shaderInputs.emplace_back(shaders::ShaderInput {
-				.shaderBytes = shaders::readFileAsBytes(desc.source),
+		// If the targets include the input, we'll just copy the data. Everything else needs a compiler.
+		if (!canGenerateTargets(desc)) {
+			std::cerr << ">> Did not find a method to compile shader from source: " << desc.source.filename() << std::endl;
+			continue;
+		}
+
+		if (needsCompileJob(desc) && desc.lang == shaders::ShaderLang::GLSL && desc.entryPoints.size() > 1) {
+			std::cerr << ">> Cannot compile GLSL with more than 1 entry points." << std::endl;
+			return -1;
+		}
+		sourceReads.emplace_back(JobOrigin { .library = libraryIndex, .description = i });
+	}
+	return 0;
+}
+
+// Reads the sources of all queued descriptions at once, copies the ones that need no compiling into their
+// libraries and creates compile jobs for the others.
+std::int32_t createJobs(std::vector<PendingLibrary>& libraries, const ProcessorOptions& options, std::span<const JobOrigin> sourceReads,
+                        std::vector<shaders::CompileJob>& jobs, std::vector<JobOrigin>& jobOrigins) {
+	std::vector<fs::path> sourcePaths;
+	sourcePaths.reserve(sourceReads.size());
+	for (const auto& origin : sourceReads) {
+		sourcePaths.emplace_back(libraries[origin.library].json.descriptions[origin.description].source);
+	}
+	auto sources = shaders::readFiles(sourcePaths);
+
+	std::vector<const shaders::ShaderJsonDesc*> jobDescs;
+	std::vector<std::string> jobSources;
+	for (std::size_t i = 0; i < sourceReads.size(); ++i) {
+		auto& library = libraries[sourceReads[i].library];
+		const auto& desc = library.json.descriptions[sourceReads[i].description];
+		if (!sources[i].has_value()) {
+			std::cerr << ">> Failed to read shader source: " << desc.source << std::endl;
+			return -1;
+		}
+
+		// A single parse of the source produces every target, so a description has at most one compile job.
+		if (needsCompileJob(desc)) {
+			jobDescs.emplace_back(&desc);
+			jobSources.emplace_back(reinterpret_cast<const char*>(sources[i]->data()), sources[i]->size());
+			jobOrigins.emplace_back(sourceReads[i]);
+		}
+
+		// The SPIR-V is added before the MSL translated from it, so that lookups by name or stage find it first.
+		const auto& frontEntry = desc.entryPoints.front();
+		bool translatesToMsl = desc.lang == shaders::ShaderLang::SPIRV && hasTarget(desc.target, shaders::ShaderLang::MSL);
+		if (hasTarget(desc.target, desc.lang)) {
+			auto spirvVersion = desc.lang == shaders::ShaderLang::SPIRV ? getSpirvVersion(*sources[i]) : shaders::SPVVersion {};
+			if (!spirvVersion.has_value()) {
+				std::cerr << ">> Unsupported SPIR-V version, only 1.3 to 1.6 are supported: " << desc.source << std::endl;
+				return -1;
+			}
+			library.descriptionInputs[sourceReads[i].description].emplace_back(shaders::ShaderInput {
+				.shaderBytes = translatesToMsl ? *sources[i] : std::move(*sources[i]),
 				.shaderName = desc.name,
 				.name = frontEntry.name,
 				.stage = frontEntry.stage,
-				.lang = desc.target,
+				.lang = desc.lang,
+				.spirvVersion = *spirvVersion,
+				.group = desc.group,
 			});
 		}
 
-		switch (desc.lang) {
-			case shaders::ShaderLang::GLSL: {
-#ifdef WITH_GLSLANG_SHADERS
-				if (desc.entryPoints.size() > 1 && !desc.entryPoints.empty()) {
-					std::cerr << ">> Cannot compile GLSL with more than 1 entry points." << std::endl;
-					return -1;
-				}
+#ifdef WITH_SPIRV_CROSS
+		if (translatesToMsl) {
+			if (auto ret = addMslInput(library, sourceReads[i].description, *sources[i], frontEntry); ret != 0) {
+				return ret;
+			}
+		}
+#endif
+	}
 
-				if (desc.target == shaders::ShaderLang::SPIRV) {
-					auto spirv = shaders::compileGlsl(desc);
-					if (spirv.empty()) {
-						std::cerr << ">> Failed to compile glslang: " << desc.name << std::endl;
-						return -1;
-					}
+	auto createdJobs = shaders::createCompileJobs(jobDescs, jobSources, options.threadCount, options.jobServer ? &*options.jobServer : nullptr);
+	jobs.reserve(createdJobs.size());
+	for (std::size_t i = 0; i < createdJobs.size(); ++i) {
+		if (!createdJobs[i].has_value()) {
+			std::cerr << ">> Failed to compile " << magic_enum::enum_name(jobDescs[i]->lang) << ": " << jobDescs[i]->name << std::endl;
+			return -1;
+		}
+		for (const auto& include : createdJobs[i]->includes) {
+			addInputPath(libraries[jobOrigins[i].library], include);
+		}
+		jobs.emplace_back(std::move(*createdJobs[i]));
+	}
+	return 0;
+}
+
+// Moves the result of a compile job into the inputs of the library it was created for, in the order of the targets.
+std::int32_t collectJobResult(PendingLibrary& library, std::size_t descriptionIndex, shaders::CompileJobResult& spirv) {
+	const auto& desc = library.json.descriptions[descriptionIndex];
+	auto versionCount = desc.spirvVersions.size();
+	if (spirv.size() != desc.entryPoints.size() * versionCount) {
+		std::cerr << ">> Failed to compile " << magic_enum::enum_name(desc.lang) << ": " << desc.name << std::endl;
+		return -1;
+	}
+
+	for (std::size_t index = 0; index < spirv.size(); ++index) {
+		const auto& entryPoint = desc.entryPoints[index / versionCount];
+		if (spirv[index].empty()) {
+			std::cerr << ">> Failed to compile " << magic_enum::enum_name(desc.lang) << ": " << entryPoint.name << std::endl;
+			return -1;
+		}
+
+		if (!hasTarget(desc.target, shaders::ShaderLang::SPIRV)) {
+			continue;
+		}
+
+		std::vector<std::byte> spirvBytes(spirv[index].size() * sizeof(std::uint32_t));
+		std::memcpy(spirvBytes.data(), spirv[index].data(), spirvBytes.size());
+		library.descriptionInputs[descriptionIndex].emplace_back(shaders::ShaderInput {
+			.shaderBytes = std::move(spirvBytes),
+			.shaderName = desc.name,
+			.name = entryPoint.name,
+			.stage = entryPoint.stage,
+			.lang = shaders::ShaderLang::SPIRV,
+			.spirvVersion = desc.spirvVersions[index % versionCount],
+			.group = desc.group,
+		});
+	}
 
-					std::vector<std::byte> spirvBytes(spirv.size() * sizeof(std::uint32_t));
-					std::memcpy(spirvBytes.data(), spirv.data(), spirvBytes.size());
-
-					shaderInputs.emplace_back(shaders::ShaderInput {
-						.shaderBytes = spirvBytes,
-						.shaderName = desc.name,
-						.name = frontEntry.name,
-						.stage = frontEntry.stage,
-						.lang = shaders::ShaderLang::SPIRV,
-					});
-				} else
+#ifdef WITH_SPIRV_CROSS
+	// The MSL comes after all SPIR-V, so that lookups by name or stage find the SPIR-V first. It is translated from
+	// the lowest version, which is the first one of every entry point.
+	if (hasTarget(desc.target, shaders::ShaderLang::MSL)) {
+		for (std::size_t index = 0; index < spirv.size(); index += versionCount) {
+			auto spirvBytes = std::as_bytes(std::span { spirv[index] });
+			if (auto ret = addMslInput(library, descriptionIndex, spirvBytes, desc.entryPoints[index / versionCount]); ret != 0) {
+				return ret;
+			}
+		}
+	}
 #endif
-				{
-					std::cerr << ">> Cannot compile GLSL." << std::endl;
-				}
-				break;
+	return 0;
+}
+
+// Orders the inputs by their first use in the access trace, which has a "shader:entryPoint" line for every use
+// recorded at runtime. This keeps shaders that are used together next to each other in the file.
+// All targets of a shader are placed at its first use. Inputs that do not appear in the trace are stored last, in
+// declaration order.
+std::int32_t getTracePlacement(const fs::path& tracePath, std::span<const shaders::ShaderInput> inputs, std::vector<std::size_t>& placement) {
+	std::ifstream trace(tracePath);
+	if (!trace) {
+		std::cerr << "Failed to open access trace: " << tracePath << std::endl;
+		return -1;
+	}
+
+	std::unordered_map<std::string, std::vector<std::size_t>> inputIndices;
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		inputIndices[inputs[i].shaderName + ':' + inputs[i].name].emplace_back(i);
+	}
+
+	std::vector<bool> placed(inputs.size());
+	placement.clear();
+	std::string line;
+	while (std::getline(trace, line)) {
+		auto it = inputIndices.find(line);
+		if (it == inputIndices.end()) {
+			continue;
+		}
+		for (auto index : it->second) {
+			if (!placed[index]) {
+				placed[index] = true;
+				placement.emplace_back(index);
 			}
-			case shaders::ShaderLang::SLANG: {
-#ifdef WITH_SLANG_SHADERS
-				if (desc.target == shaders::ShaderLang::SPIRV) {
-					auto spirv = shaders::compileSlang(desc);
-					if (spirv.empty()) {
-						std::cerr << ">> Failed to compile slang: " << desc.name << std::endl;
-						return -1;
-					}
+		}
+	}
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		if (!placed[i]) {
+			placement.emplace_back(i);
+		}
+	}
+	return 0;
+}
 
-					for (auto it = spirv.begin(); it != spirv.end(); ++it) {
-						auto index = std::distance(spirv.begin(), it);
-
-						if (it->empty()) {
-							std::cerr << ">> Failed to compile slang: " << desc.entryPoints[index].name << std::endl;
-							return -1;
-						}
-
-						std::vector<std::byte> spirvBytes(it->size() * sizeof(std::uint32_t));
-						std::memcpy(spirvBytes.data(), it->data(), it->size() * sizeof(std::uint32_t));
-						shaderInputs.emplace_back(shaders::ShaderInput {
-							.shaderBytes = std::move(spirvBytes),
-							.shaderName = desc.name,
-							.name = desc.entryPoints[index].name,
-							.stage = desc.entryPoints[index].stage,
-							.lang = shaders::ShaderLang::SPIRV,
-						});
-					}
-				} else
+std::int32_t buildLibrary(PendingLibrary& library, const ProcessorOptions& options, std::vector<std::byte>& libraryBytes) {
+	std::vector<shaders::ShaderInput> shaderInputs;
+	shaderInputs.reserve(library.json.descriptions.size());
+	for (auto& inputs : library.descriptionInputs) {
+		std::move(inputs.begin(), inputs.end(), std::back_inserter(shaderInputs));
+	}
+
+#ifdef WITH_SPIRV_CROSS
+	// Reflect every SPIR-V binary now, so that the runtime does not need to do it when loading.
+	for (auto& input : shaderInputs) {
+		if (input.lang == shaders::ShaderLang::SPIRV) {
+			input.reflection = shaders::reflectSpirv(input.shaderBytes, shaders::ShaderEntryPoint { .stage = input.stage, .name = input.name });
+		}
+	}
 #endif
-				{
-					std::cerr << ">> Cannot compile slang." << std::endl;
-				}
-				break;
+
+	if (shaderInputs.empty()) {
+		std::cerr << "All shaders failed to compile. Cannot build binary \"" << library.json.name << "\"." << std::endl;
+		return -1;
+	}
+
+	if (options.compactSpirv) {
+		for (auto& input : shaderInputs) {
+			input.codec = shaders::ShaderCodec::CompactSpirv;
+		}
+	}
+
+	if (options.groupByStage) {
+		for (auto& input : shaderInputs) {
+			if (input.group.empty()) {
+				input.group = magic_enum::enum_name(input.stage);
+				std::transform(input.group.begin(), input.group.end(), input.group.begin(), [](unsigned char c) {
+					return static_cast<char>(std::tolower(c));
+				});
 			}
-			default: {
-				std::cerr << ">> Did not find a method to compile shader from source: " << desc.source.filename() << std::endl;
+		}
+	}
+
+	std::vector<std::size_t> placement;
+	if (!options.accessTracePath.empty()) {
+		if (auto ret = getTracePlacement(options.accessTracePath, shaderInputs, placement); ret != 0) {
+			return ret;
+		}
+	}
+
+	libraryBytes = shaders::buildShaderLibrary(std::move(shaderInputs), placement);
+	return 0;
+}
+
+// Processes all given libraries at once, so that the compile jobs of every library can be scheduled together.
+std::int32_t processLibraries(std::vector<PendingLibrary>& libraries, const ProcessorOptions& options, const fs::path& outputFolder) {
+	// A single parser is reused for all JSONs, so that its buffers are only allocated once.
+	simdjson::dom::parser parser;
+	std::vector<JobOrigin> sourceReads;
+	for (std::size_t i = 0; i < libraries.size(); ++i) {
+		std::cout << "Processing " << fs::relative(libraries[i].jsonPath, fs::current_path()).string() << std::endl;
+		if (auto ret = queueJson(libraries[i], i, parser, sourceReads); ret != 0) {
+			return ret;
+		}
+	}
+
+	// The compilers are initialized in the background while the sources are read and preprocessed, as creating a
+	// Slang session alone takes hundreds of milliseconds. Jobs that need a compiler before it is ready wait for it,
+	// while the others already run. Jobs sent to workers or worker processes need no compiler in this process, and
+	// worker processes have to be forked while no other thread is running.
+	std::vector<shaders::ShaderLang> compileLangs;
+	for (const auto& origin : sourceReads) {
+		const auto& desc = libraries[origin.library].json.descriptions[origin.description];
+		if (needsCompileJob(desc) && std::find(compileLangs.begin(), compileLangs.end(), desc.lang) == compileLangs.end()) {
+			compileLangs.emplace_back(desc.lang);
+		}
+	}
+	std::thread warmup;
+	if (!compileLangs.empty() && options.workerAddresses.empty() && !options.processPool) {
+		warmup = std::thread([compileLangs]() {
+			for (auto lang : compileLangs) {
+				shaders::initializeCompiler(lang);
 			}
+		});
+	}
+
+	std::vector<shaders::CompileJob> jobs;
+	std::vector<JobOrigin> jobOrigins;
+	auto createResult = createJobs(libraries, options, sourceReads, jobs, jobOrigins);
+	std::vector<shaders::CompileJobResult> results;
+	if (createResult == 0) {
+		results = executeCompileJobs(options, jobs);
+	}
+	if (warmup.joinable()) {
+		warmup.join();
+	}
+	if (createResult != 0) {
+		return createResult;
+	}
+
+	for (std::size_t i = 0; i < jobs.size(); ++i) {
+		auto& origin = jobOrigins[i];
+		if (auto ret = collectJobResult(libraries[origin.library], origin.description, results[i]); ret != 0) {
+			return ret;
 		}
 	}
 
-	if (shaderInputs.empty()) {
-		std::cerr << "All shaders failed to compile. Cannot build binary \"" << json.name << "\"." << std::endl;
-		return -1;
+	// Outputs are written in the background while the next library is built.
+	shaders::AsyncFileWriter writer;
+	std::vector<shaders::ShaderBundleInput> bundleInputs;
+	for (auto& library : libraries) {
+		std::vector<std::byte> libraryBytes;
+		if (auto ret = buildLibrary(library, options, libraryBytes); ret != 0) {
+			return ret;
+		}
+
+		if (options.idHeader) {
+			auto idHeader = generateIdHeader(library.outputName, libraryBytes);
+			if (!idHeader.has_value()) {
+				return -1;
+			}
+			library.outputPaths.emplace_back(outputFolder / (library.outputName + ".ids.hpp"));
+			writer.write(library.outputPaths.back(), std::move(*idHeader));
+		}
+
+		if (options.embed) {
+			library.outputPaths.emplace_back(outputFolder / (library.outputName + ".hpp"));
+			writer.write(library.outputPaths.back(), generateEmbeddedHeader(library.outputName, libraryBytes));
+		} else if (options.bundleName.empty()) {
+			library.outputPaths.emplace_back(outputFolder / (library.outputName + ".shader"));
+			writer.write(library.outputPaths.back(), std::move(libraryBytes));
+		} else {
+			bundleInputs.emplace_back(shaders::ShaderBundleInput {
+				.name = std::move(library.outputName),
+				.libraryBytes = std::move(libraryBytes),
+			});
+		}
 	}
 
-	auto binaryBytes = shaders::buildShaderLibrary(std::move(shaderInputs));
-	std::ofstream out(outputFolder / (json.name + ".shader"), std::ios::binary | std::ios::out);
-	out.write(reinterpret_cast<const char*>(binaryBytes.data()), static_cast<std::int64_t>(binaryBytes.size()));
+	if (!options.bundleName.empty()) {
+		auto bundlePath = outputFolder / (options.bundleName + ".shaderbundle");
+		for (auto& library : libraries) {
+			library.outputPaths.emplace_back(bundlePath);
+		}
+		writer.write(bundlePath, shaders::buildShaderBundle(std::move(bundleInputs)));
+	}
+	if (!writer.wait()) {
+		return -1;
+	}
 
+	// The manifests record the outputs too, so they can only be written once all outputs exist.
+	for (auto& library : libraries) {
+		writeLibraryManifest(library, options);
+	}
 	return 0;
 }
 
@@ -165,46 +773,181 @@ int main(int argc, char* argv[]) {
 		return -1;
 	}
 
-	{
-		auto outputFolder = fs::current_path() / "shaders";
-		if (!fs::exists(outputFolder)) {
-			fs::create_directory(outputFolder);
+	// Subcommands work on existing libraries, and do not need any of the compilers.
+	std::string_view command = argv[1];
+	std::span<char*> commandArgs = { std::next(argv, 2), static_cast<size_t>(argc - 2) };
+	if (command == "report") {
+		return shaders::runReportCommand(commandArgs);
+	} else if (command == "merge") {
+		return shaders::runMergeCommand(commandArgs);
+	} else if (command == "filter") {
+		return shaders::runFilterCommand(commandArgs);
+	} else if (command == "split") {
+		return shaders::runSplitCommand(commandArgs);
+	} else if (command == "diff") {
+		return shaders::runDiffCommand(commandArgs);
+	} else if (command == "patch") {
+		return shaders::runPatchCommand(commandArgs);
+	}
+
+	ProcessorOptions options;
+	std::string listenAddress;
+	fs::path manifestPath;
+	fs::path stampPath;
+	std::vector<PendingLibrary> libraries;
+	std::span<char*> args = { std::next(argv), static_cast<size_t>(argc - 1) };
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--embed") {
+			options.embed = true;
+		} else if (arg == "--header") {
+			options.idHeader = true;
+		} else if (arg == "--compact-spirv") {
+			options.compactSpirv = true;
+		} else if (arg == "--group-by-stage") {
+			options.groupByStage = true;
+		} else if (arg == "--force") {
+			options.force = true;
+		} else if (arg == "--process-pool") {
+			options.processPool = true;
+		} else if (arg == "--bundle" || arg == "--listen" || arg == "--workers" || arg == "--manifest" || arg == "--stamp" || arg == "--jobs" ||
+		           arg == "--timings" || arg == "--access-trace") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			std::string_view value = *(++it);
+
+			if (arg == "--bundle") {
+				options.bundleName = value;
+			} else if (arg == "--listen") {
+				listenAddress = value;
+			} else if (arg == "--manifest") {
+				manifestPath = value;
+			} else if (arg == "--stamp") {
+				stampPath = value;
+			} else if (arg == "--timings") {
+				options.timingsPath = value;
+			} else if (arg == "--access-trace") {
+				options.accessTracePath = value;
+			} else if (arg == "--jobs") {
+				auto [ptr, error] = std::from_chars(value.data(), value.data() + value.size(), options.threadCount);
+				if (error != std::errc {} || ptr != value.data() + value.size() || options.threadCount == 0) {
+					std::cerr << "Invalid job count: " << value << std::endl;
+					return -1;
+				}
+			} else {
+				// This is a comma separated list of worker addresses.
+				for (std::size_t begin = 0; begin <= value.size();) {
+					auto end = std::min(value.find(',', begin), value.size());
+					if (end != begin) {
+						options.workerAddresses.emplace_back(value.substr(begin, end - begin));
+					}
+					begin = end + 1;
+				}
+			}
+		} else {
+			auto& library = libraries.emplace_back();
+			library.jsonPath = arg;
 		}
 	}
 
-#ifdef WITH_GLSLANG_SHADERS
-	glslang::InitializeProcess();
-#endif
+	if (!manifestPath.empty()) {
+		simdjson::dom::parser parser;
+		shaders::ShaderManifest manifest;
+		if (auto ret = shaders::parseManifest(manifestPath, manifest, parser); ret != 0) {
+			return ret;
+		}
 
-#ifdef WITH_SLANG_SHADERS
-	shaders::slangSession = spCreateSession(); // Not fully threadsafe.
-#endif
+		for (auto& entry : manifest.entries) {
+			auto& library = libraries.emplace_back();
+			library.jsonPath = std::move(entry.json);
+			library.outputName = std::move(entry.outputName);
+		}
+		if (stampPath.empty()) {
+			stampPath = manifest.stamp;
+		}
+	}
 
-#ifdef WITH_SPIRV_CROSS
-	spvc_context_create(&shaders::spvcContext);
+#ifndef WITH_REMOTE_COMPILE
+	if (!listenAddress.empty() || !options.workerAddresses.empty()) {
+		std::cerr << "Remote compilation is not supported on this platform." << std::endl;
+		return -1;
+	}
+	if (options.processPool) {
+		std::cerr << "--process-pool is not supported on this platform." << std::endl;
+		return -1;
+	}
 #endif
 
-	std::span<char*> args = { std::next(argv), static_cast<size_t>(argc - 1) };
-	for (auto& arg : args) {
-		std::cout << "Processing " << fs::relative(arg, fs::current_path()).string() << std::endl;
-		auto ret = processJson(fs::path { arg });
-		if (ret != 0) {
-			return ret;
+	if (options.embed && !options.bundleName.empty()) {
+		std::cerr << "--embed cannot be combined with --bundle." << std::endl;
+		return -1;
+	}
+
+	if (libraries.empty() && listenAddress.empty()) {
+		std::cerr << "No json path specified. " << std::endl;
+		return -1;
+	}
+
+	// Make only passes its jobserver to commands marked as jobserver aware, which create_shader_targets does.
+	options.jobServer = shaders::JobServerClient::fromEnvironment();
+
+	auto outputFolder = fs::current_path() / "shaders";
+	if (listenAddress.empty() && !fs::exists(outputFolder)) {
+		fs::create_directory(outputFolder);
+	}
+
+	if (listenAddress.empty()) {
+		// Build systems run the processor with its full path, which is used when the running executable is not known.
+		std::error_code error;
+		options.executablePath = fs::read_symlink("/proc/self/exe", error);
+		if (error && fs::path { argv[0] }.has_parent_path()) {
+			options.executablePath = fs::absolute(argv[0]);
+		}
+
+		for (auto& library : libraries) {
+			library.outputOptions = getOutputOptions(options, library);
+			library.manifestPath = getInputManifestPath(outputFolder, library.jsonPath);
+		}
+		if (!options.force) {
+			skipUnchangedLibraries(libraries, options);
+		}
+
+		// Nothing changed, so there is nothing to process.
+		if (libraries.empty()) {
+			if (!stampPath.empty()) {
+				std::ofstream stamp(stampPath, std::ios::out | std::ios::trunc);
+			}
+			return 0;
+		}
+
+		for (auto& library : libraries) {
+			if (!options.executablePath.empty()) {
+				addInputPath(library, options.executablePath);
+			}
+			if (!options.accessTracePath.empty()) {
+				addInputPath(library, options.accessTracePath);
+			}
 		}
 	}
 
-#ifdef WITH_SPIRV_CROSS
-	spvc_context_release_allocations(shaders::spvcContext);
-	spvc_context_destroy(shaders::spvcContext);
+#ifdef WITH_REMOTE_COMPILE
+	if (!listenAddress.empty()) {
+		// Workers only execute jobs sent to them, and run until they are killed.
+		return shaders::runCompileWorker(listenAddress);
+	}
 #endif
 
-#ifdef WITH_SLANG_SHADERS
-	spDestroySession(shaders::slangSession);
-#endif
+	if (auto ret = processLibraries(libraries, options, outputFolder); ret != 0) {
+		return ret;
+	}
 
-#ifdef WITH_GLSLANG_SHADERS
-	glslang::FinalizeProcess();
-#endif
+	// The stamp is only written on success, so that build systems retry failed builds.
+	if (!stampPath.empty()) {
+		std::ofstream stamp(stampPath, std::ios::out | std::ios::trunc);
+	}
 
+	shaders::finalizeCompilers();
 	return 0;
 }
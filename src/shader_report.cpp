@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef SIMDJSON_EXCEPTIONS
+#define SIMDJSON_EXCEPTIONS 1
+#endif
+
+#include <simdjson.h>
+#include <magic_enum.hpp>
+
+#include <shaders/shader_report.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+	constexpr std::uint32_t spirvMagic = 0x07230203;
+	constexpr std::size_t spirvHeaderWords = 5;
+	constexpr std::uint32_t spirvOpFunction = 54;
+
+	void countSpirvInstructions(std::span<const std::byte> bytes, shaders::ShaderReportEntry& entry) {
+		auto wordCount = bytes.size() / sizeof(std::uint32_t);
+		auto readWord = [&](std::size_t index) {
+			std::uint32_t word = 0;
+			std::memcpy(&word, bytes.data() + index * sizeof(std::uint32_t), sizeof(word));
+			return word;
+		};
+
+		if (wordCount < spirvHeaderWords || readWord(0) != spirvMagic) {
+			return;
+		}
+		entry.idBound = readWord(3);
+
+		for (auto i = spirvHeaderWords; i < wordCount;) {
+			auto word = readWord(i);
+			auto instructionWords = word >> 16;
+			if (instructionWords == 0) {
+				// Malformed SPIR-V, stop here instead of looping forever.
+				break;
+			}
+
+			++entry.instructionCount;
+			if ((word & 0xFFFF) == spirvOpFunction) {
+				++entry.functionCount;
+			}
+			i += instructionWords;
+		}
+	}
+
+	[[nodiscard]] std::string getEntryName(const shaders::ShaderReportEntry& entry) {
+		return entry.shaderName + ':' + entry.entryPoint;
+	}
+
+	// Includes the target, as an entry point can be stored for several of them. Entries from reports without a
+	// language only have their name as the key.
+	[[nodiscard]] std::string getEntryKey(const shaders::ShaderReportEntry& entry) {
+		if (entry.lang == static_cast<shaders::ShaderLang>(0)) {
+			return getEntryName(entry);
+		}
+		std::string target { entry.lang == shaders::ShaderLang::SPIRV ? magic_enum::enum_name(entry.spirvVersion)
+		                                                               : magic_enum::enum_name(entry.lang) };
+		std::transform(target.begin(), target.end(), target.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return getEntryName(entry) + '@' + target;
+	}
+
+	[[nodiscard]] double getGrowthPercent(std::uint64_t baseline, std::uint64_t current) {
+		if (baseline == 0) {
+			return current == 0 ? 0.0 : 100.0;
+		}
+		return (static_cast<double>(current) - static_cast<double>(baseline)) / static_cast<double>(baseline) * 100.0;
+	}
+
+	void writeJsonString(std::ostream& out, std::string_view string) {
+		out << '"';
+		for (auto c : string) {
+			if (c == '"' || c == '\\') {
+				out << '\\';
+			}
+			out << c;
+		}
+		out << '"';
+	}
+} // namespace
+
+shaders::ShaderReport shaders::createShaderReport(const ShaderLibrary& library) {
+	ShaderReport report;
+	for (const auto& binary : library.getShaderBinaries()) {
+		auto& entry = report.entries.emplace_back(ShaderReportEntry {
+			.shaderName = std::string { binary.shaderName },
+			.entryPoint = std::string { binary.name },
+			.stage = binary.stage,
+			.lang = binary.lang,
+			.spirvVersion = binary.spirvVersion,
+			.byteSize = binary.bytes.size(),
+		});
+		if (binary.lang == ShaderLang::SPIRV) {
+			countSpirvInstructions(binary.bytes, entry);
+		}
+	}
+	return report;
+}
+
+std::string shaders::serializeShaderReport(const ShaderReport& report) {
+	std::ostringstream out;
+	out << "{\n  \"shaders\": [";
+	for (std::size_t i = 0; i < report.entries.size(); ++i) {
+		const auto& entry = report.entries[i];
+		out << (i == 0 ? "\n    { " : ",\n    { ") << "\"name\": ";
+		writeJsonString(out, entry.shaderName);
+		out << ", \"entryPoint\": ";
+		writeJsonString(out, entry.entryPoint);
+		out << ", \"stage\": \"" << magic_enum::enum_name(entry.stage) << "\", \"lang\": \"" << magic_enum::enum_name(entry.lang)
+		    << "\", \"spirvVersion\": \"" << magic_enum::enum_name(entry.spirvVersion) << "\", \"byteSize\": " << entry.byteSize << ", \"instructionCount\": " << entry.instructionCount
+		    << ", \"functionCount\": " << entry.functionCount << ", \"idBound\": " << entry.idBound << " }";
+	}
+	out << "\n  ]\n}\n";
+	return out.str();
+}
+
+std::int32_t shaders::readShaderReport(const fs::path& path, ShaderReport& report) {
+	std::uint32_t magic = 0;
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			std::cerr << "Report file does not exist: " << path << std::endl;
+			return -1;
+		}
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	}
+
+	if (magic == headerMagic) {
+		auto library = readShaderLibraryFromFile(path);
+		if (library.getShaderBinaries().empty()) {
+			std::cerr << "Failed to read shader library: " << path << std::endl;
+			return -1;
+		}
+		report = createShaderReport(library);
+		return 0;
+	}
+
+	simdjson::dom::parser parser;
+	simdjson::dom::array shadersArray;
+	if (auto error = parser.load(path.string())["shaders"].get_array().get(shadersArray); error != 0) {
+		std::cerr << "Failed to get shaders array from report: " << simdjson::error_message(error) << std::endl;
+		return -1;
+	}
+
+	report.entries.clear();
+	for (auto element : shadersArray) {
+		std::string_view name;
+		std::string_view entryPoint;
+		std::string_view stage;
+		std::string_view lang;
+		std::string_view spirvVersion;
+		std::uint64_t byteSize = 0;
+		std::uint64_t instructionCount = 0;
+		std::uint64_t functionCount = 0;
+		std::uint64_t idBound = 0;
+		if (element["name"].get(name) != 0 || element["entryPoint"].get(entryPoint) != 0 || element["byteSize"].get(byteSize) != 0) {
+			std::cerr << "Malformed entry in report: " << path << std::endl;
+			return -1;
+		}
+
+		// The remaining fields are optional, so that reports from other tools can be used as a baseline.
+		auto getOptional = [&element](std::string_view key, auto& value) {
+			if (element[key].get(value) != 0) {
+				value = {};
+			}
+		};
+		getOptional("stage", stage);
+		getOptional("lang", lang);
+		getOptional("spirvVersion", spirvVersion);
+		getOptional("instructionCount", instructionCount);
+		getOptional("functionCount", functionCount);
+		getOptional("idBound", idBound);
+		report.entries.emplace_back(ShaderReportEntry {
+			.shaderName = std::string { name },
+			.entryPoint = std::string { entryPoint },
+			.stage = magic_enum::enum_cast<ShaderStage>(stage).value_or(static_cast<ShaderStage>(0)),
+			.lang = magic_enum::enum_cast<ShaderLang>(lang).value_or(static_cast<ShaderLang>(0)),
+			.spirvVersion = magic_enum::enum_cast<SPVVersion>(spirvVersion).value_or(SPVVersion::SPV_1_3),
+			.byteSize = byteSize,
+			.instructionCount = static_cast<std::uint32_t>(instructionCount),
+			.functionCount = static_cast<std::uint32_t>(functionCount),
+			.idBound = static_cast<std::uint32_t>(idBound),
+		});
+	}
+	return 0;
+}
+
+bool shaders::printShaderReport(const ShaderReport& report, const ShaderReport* baseline, double maxGrowthPercent) {
+	std::unordered_map<std::string, const ShaderReportEntry*> baselineEntries;
+	std::uint64_t baselineTotal = 0;
+	if (baseline != nullptr) {
+		for (const auto& entry : baseline->entries) {
+			baselineEntries.emplace(getEntryKey(entry), &entry);
+			baselineTotal += entry.byteSize;
+		}
+	}
+
+	bool withinBudget = true;
+	std::uint64_t total = 0;
+	std::cout << std::left << std::setw(40) << "shader" << std::right << std::setw(12) << "bytes" << std::setw(14) << "instructions"
+	          << std::setw(11) << "functions" << std::setw(9) << "idBound" << std::endl;
+	for (const auto& entry : report.entries) {
+		total += entry.byteSize;
+		std::cout << std::left << std::setw(40) << getEntryKey(entry) << std::right << std::setw(12) << entry.byteSize << std::setw(14)
+		          << entry.instructionCount << std::setw(11) << entry.functionCount << std::setw(9) << entry.idBound;
+
+		if (baseline != nullptr) {
+			auto it = baselineEntries.find(getEntryKey(entry));
+			if (it == baselineEntries.end()) {
+				it = baselineEntries.find(getEntryName(entry));
+			}
+			if (it == baselineEntries.end()) {
+				std::cout << "  (new)";
+			} else {
+				auto sizeGrowth = getGrowthPercent(it->second->byteSize, entry.byteSize);
+				auto instructionGrowth = getGrowthPercent(it->second->instructionCount, entry.instructionCount);
+				std::cout << "  " << std::showpos << std::fixed << std::setprecision(1) << sizeGrowth << "% bytes, " << instructionGrowth
+				          << "% instructions" << std::noshowpos;
+				if (sizeGrowth > maxGrowthPercent || instructionGrowth > maxGrowthPercent) {
+					std::cout << "  over budget";
+					withinBudget = false;
+				}
+				baselineEntries.erase(it);
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	if (baseline != nullptr) {
+		for (const auto& entry : baseline->entries) {
+			if (baselineEntries.contains(getEntryKey(entry))) {
+				std::cout << std::left << std::setw(40) << getEntryKey(entry) << std::right << "  (removed)" << std::endl;
+			}
+		}
+	}
+
+	std::cout << "Total: " << total << " bytes";
+	if (baseline != nullptr) {
+		auto totalGrowth = getGrowthPercent(baselineTotal, total);
+		std::cout << ", " << std::showpos << std::fixed << std::setprecision(1) << totalGrowth << "%" << std::noshowpos << " compared to "
+		          << baselineTotal << " bytes";
+		if (totalGrowth > maxGrowthPercent) {
+			std::cout << ", over budget";
+			withinBudget = false;
+		}
+	}
+	std::cout << std::endl;
+	return withinBudget;
+}
+
+std::int32_t shaders::runReportCommand(std::span<char*> args) {
+	fs::path libraryPath;
+	fs::path baselinePath;
+	fs::path outputPath;
+	// Without a threshold the comparison is only printed.
+	double maxGrowthPercent = std::numeric_limits<double>::infinity();
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--baseline" || arg == "--output" || arg == "--max-growth") {
+			if (std::next(it) == args.end()) {
+				std::cerr << "Missing value after " << arg << "." << std::endl;
+				return -1;
+			}
+			std::string_view value = *(++it);
+
+			if (arg == "--baseline") {
+				baselinePath = value;
+			} else if (arg == "--output") {
+				outputPath = value;
+			} else {
+				// std::from_chars for floating point is not available everywhere yet.
+				std::string valueString { value };
+				char* end = nullptr;
+				maxGrowthPercent = std::strtod(valueString.c_str(), &end);
+				if (valueString.empty() || end != valueString.c_str() + valueString.size()) {
+					std::cerr << "Invalid growth threshold: " << value << std::endl;
+					return -1;
+				}
+			}
+		} else {
+			libraryPath = arg;
+		}
+	}
+
+	if (libraryPath.empty()) {
+		std::cerr << "No shader library specified." << std::endl;
+		return -1;
+	}
+
+	ShaderReport report;
+	if (auto ret = readShaderReport(libraryPath, report); ret != 0) {
+		return ret;
+	}
+
+	if (!outputPath.empty()) {
+		auto serialized = serializeShaderReport(report);
+		std::ofstream out(outputPath, std::ios::out | std::ios::trunc);
+		out.write(serialized.data(), static_cast<std::streamsize>(serialized.size()));
+	}
+
+	ShaderReport baseline;
+	if (!baselinePath.empty()) {
+		if (auto ret = readShaderReport(baselinePath, baseline); ret != 0) {
+			return ret;
+		}
+	}
+
+	if (!printShaderReport(report, baselinePath.empty() ? nullptr : &baseline, maxGrowthPercent)) {
+		std::cerr << "Shader library grew by more than " << maxGrowthPercent << "%." << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstring>
+
+#include <shaders/spirv_codec.hpp>
+
+namespace {
+	constexpr std::uint32_t spirvMagic = 0x07230203;
+	constexpr std::size_t spirvHeaderWords = 5;
+
+	// Word counts above this are stored in an additional varint.
+	constexpr std::uint32_t inlineWordCountLimit = 15;
+	constexpr std::uint32_t inlineWordCountBits = 4;
+
+	enum class OperandEncoding {
+		// Every operand word as a varint.
+		Plain,
+		// The result type as a varint, the result ID relative to the previous result ID plus one, and every other
+		// operand relative to the result ID, as most of them reference recent results.
+		Result,
+		// Operands that contain strings are copied as they are, as the varints of text would be larger.
+		Raw,
+	};
+
+	[[nodiscard]] constexpr bool inRange(std::uint32_t opcode, std::uint32_t first, std::uint32_t last) {
+		return opcode >= first && opcode <= last;
+	}
+
+	// Only affects the size of the encoding, as both sides use the same table. The ranges cover the opcodes
+	// with a result type and a result ID that are common in function bodies.
+	[[nodiscard]] constexpr OperandEncoding getOperandEncoding(std::uint32_t opcode, std::uint32_t wordCount) {
+		switch (opcode) {
+			case 2: // OpSourceContinued
+			case 3: // OpSource
+			case 4: // OpSourceExtension
+			case 5: // OpName
+			case 6: // OpMemberName
+			case 7: // OpString
+			case 10: // OpExtension
+			case 11: // OpExtInstImport
+			case 15: // OpEntryPoint
+			case 330: // OpModuleProcessed
+			case 5632: // OpDecorateString
+			case 5633: // OpMemberDecorateString
+				return OperandEncoding::Raw;
+			default:
+				break;
+		}
+
+		if (wordCount < 3) {
+			return OperandEncoding::Plain;
+		}
+
+		// OpUndef, OpExtInst, OpConstantTrue/False, OpConstantComposite, OpConstantNull, OpFunction(Parameter),
+		// OpFunctionCall, OpVariable to OpLoad, the access chains, composite and image instructions, conversions,
+		// arithmetic, relational, logical, bit and derivative instructions, and OpPhi.
+		if (opcode == 1 || opcode == 12 || inRange(opcode, 41, 42) || opcode == 44 || opcode == 46 || inRange(opcode, 54, 55) || opcode == 57
+		    || inRange(opcode, 59, 61) || inRange(opcode, 65, 68) || inRange(opcode, 77, 84) || inRange(opcode, 86, 98)
+		    || inRange(opcode, 100, 107) || inRange(opcode, 109, 124) || inRange(opcode, 126, 152) || inRange(opcode, 154, 191)
+		    || inRange(opcode, 194, 205) || inRange(opcode, 207, 215) || opcode == 245) {
+			return OperandEncoding::Result;
+		}
+		return OperandEncoding::Plain;
+	}
+
+	[[nodiscard]] constexpr std::uint64_t zigzag(std::int64_t value) {
+		return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+	}
+
+	[[nodiscard]] constexpr std::int64_t unzigzag(std::uint64_t value) {
+		return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+	}
+
+	void writeVarint(std::vector<std::byte>& output, std::uint64_t value) {
+		while (value >= 0x80) {
+			output.emplace_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		output.emplace_back(static_cast<std::byte>(value));
+	}
+
+	class Reader {
+		const std::uint8_t* current;
+		const std::uint8_t* end;
+
+	public:
+		bool failed = false;
+
+		explicit Reader(std::span<const std::byte> bytes)
+			: current(reinterpret_cast<const std::uint8_t*>(bytes.data())), end(current + bytes.size()) {}
+
+		[[nodiscard]] bool atEnd() const {
+			return current == end;
+		}
+
+		[[nodiscard]] std::uint64_t readVarint() {
+			// Most values are below 128, which take a single byte.
+			if (current != end && *current < 0x80) [[likely]] {
+				return *current++;
+			}
+
+			std::uint64_t value = 0;
+			for (std::uint32_t shift = 0; shift < 64 && current != end; shift += 7) {
+				auto byte = *current++;
+				value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+				if (byte < 0x80) {
+					return value;
+				}
+			}
+			failed = true;
+			return 0;
+		}
+
+		void readRaw(std::uint32_t* words, std::size_t count) {
+			if (static_cast<std::size_t>(end - current) < count * sizeof(std::uint32_t)) {
+				failed = true;
+				return;
+			}
+			std::memcpy(words, current, count * sizeof(std::uint32_t));
+			current += count * sizeof(std::uint32_t);
+		}
+	};
+} // namespace
+
+std::optional<std::vector<std::byte>> shaders::encodeCompactSpirv(std::span<const std::byte> spirv) {
+	if (spirv.size() % sizeof(std::uint32_t) != 0 || spirv.size() < spirvHeaderWords * sizeof(std::uint32_t)) {
+		return std::nullopt;
+	}
+
+	std::vector<std::uint32_t> words(spirv.size() / sizeof(std::uint32_t));
+	std::memcpy(words.data(), spirv.data(), spirv.size());
+	if (words[0] != spirvMagic) {
+		return std::nullopt;
+	}
+
+	std::vector<std::byte> output;
+	output.reserve(spirv.size() / 2);
+	writeVarint(output, words.size());
+	output.insert(output.end(), spirv.begin(), spirv.begin() + spirvHeaderWords * sizeof(std::uint32_t));
+
+	std::int64_t lastResult = 0;
+	for (auto i = spirvHeaderWords; i < words.size();) {
+		auto opcode = words[i] & 0xFFFF;
+		auto wordCount = words[i] >> 16;
+		if (wordCount == 0 || wordCount > words.size() - i) {
+			return std::nullopt;
+		}
+
+		auto extraWords = wordCount - 1;
+		writeVarint(output, (static_cast<std::uint64_t>(opcode) << inlineWordCountBits) | std::min(extraWords, inlineWordCountLimit));
+		if (extraWords >= inlineWordCountLimit) {
+			writeVarint(output, extraWords - inlineWordCountLimit);
+		}
+
+		std::span<const std::uint32_t> operands { words.data() + i + 1, extraWords };
+		switch (getOperandEncoding(opcode, wordCount)) {
+			case OperandEncoding::Raw: {
+				const auto* begin = reinterpret_cast<const std::byte*>(operands.data());
+				output.insert(output.end(), begin, begin + operands.size_bytes());
+				break;
+			}
+			case OperandEncoding::Result: {
+				std::int64_t result = operands[1];
+				writeVarint(output, operands[0]);
+				writeVarint(output, zigzag(result - (lastResult + 1)));
+				for (auto operand : operands.subspan(2)) {
+					writeVarint(output, zigzag(result - static_cast<std::int64_t>(operand)));
+				}
+				lastResult = result;
+				break;
+			}
+			case OperandEncoding::Plain: {
+				for (auto operand : operands) {
+					writeVarint(output, operand);
+				}
+				break;
+			}
+		}
+		i += wordCount;
+	}
+	return output;
+}
+
+std::optional<std::size_t> shaders::getCompactSpirvWordCount(std::span<const std::byte> encoded) {
+	Reader reader(encoded);
+	auto wordCount = reader.readVarint();
+	if (reader.failed || wordCount < spirvHeaderWords) {
+		return std::nullopt;
+	}
+	return static_cast<std::size_t>(wordCount);
+}
+
+bool shaders::decodeCompactSpirv(std::span<const std::byte> encoded, std::span<std::uint32_t> words) {
+	Reader reader(encoded);
+	if (reader.readVarint() != words.size() || words.size() < spirvHeaderWords) {
+		return false;
+	}
+	reader.readRaw(words.data(), spirvHeaderWords);
+
+	std::int64_t lastResult = 0;
+	auto* output = words.data() + spirvHeaderWords;
+	auto* end = words.data() + words.size();
+	while (output != end && !reader.failed) {
+		auto head = reader.readVarint();
+		auto opcode = static_cast<std::uint32_t>(head >> inlineWordCountBits);
+		auto extraWords = static_cast<std::uint64_t>(head & inlineWordCountLimit);
+		if (extraWords == inlineWordCountLimit) {
+			extraWords += reader.readVarint();
+		}
+
+		if (opcode > 0xFFFF || extraWords >= static_cast<std::uint64_t>(end - output)) {
+			return false;
+		}
+		auto wordCount = static_cast<std::uint32_t>(extraWords + 1);
+		*output++ = (wordCount << 16) | opcode;
+
+		switch (getOperandEncoding(opcode, wordCount)) {
+			case OperandEncoding::Raw: {
+				reader.readRaw(output, extraWords);
+				output += extraWords;
+				break;
+			}
+			case OperandEncoding::Result: {
+				output[0] = static_cast<std::uint32_t>(reader.readVarint());
+				auto result = lastResult + 1 + unzigzag(reader.readVarint());
+				output[1] = static_cast<std::uint32_t>(result);
+				for (std::size_t operand = 2; operand < extraWords; ++operand) {
+					output[operand] = static_cast<std::uint32_t>(result - unzigzag(reader.readVarint()));
+				}
+				output += extraWords;
+				lastResult = result;
+				break;
+			}
+			case OperandEncoding::Plain: {
+				for (std::size_t operand = 0; operand < extraWords; ++operand) {
+					*output++ = static_cast<std::uint32_t>(reader.readVarint());
+				}
+				break;
+			}
+		}
+	}
+	return !reader.failed && output == end && reader.atEnd();
+}
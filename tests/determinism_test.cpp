@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <shaders/shader_binary.hpp>
+
+#include "shader_corpus.hpp"
+
+namespace fs = std::filesystem;
+namespace sb = ::shaders::benchmark;
+
+struct TestOptions {
+	fs::path processorPath;
+	fs::path directory = "determinism";
+	// Also builds a GLSL corpus, which requires a shaderprocessor built with glslang.
+	bool glsl = false;
+};
+
+// An empty compute shader with a "main" entry point. The second word is the SPIR-V version.
+constexpr std::array<std::uint32_t, 47> computeSpirv = {
+	0x07230203, 0x00010300, 0x00000000, 0x00000008, 0x00000000, 0x00020011, 0x00000001, 0x0003000e, 0x00000000, 0x00000001,
+	0x0005000f, 0x00000005, 0x00000004, 0x6e69616d, 0x00000000, 0x00060010, 0x00000004, 0x00000011, 0x00000008, 0x00000001,
+	0x00000001, 0x00040005, 0x00000004, 0x6e69616d, 0x00000000, 0x00020013, 0x00000002, 0x00030021, 0x00000003, 0x00000002,
+	0x00040015, 0x00000006, 0x00000020, 0x00000000, 0x0004002b, 0x00000006, 0x00000007, 0x0000002a, 0x00050036, 0x00000002,
+	0x00000004, 0x00000000, 0x00000003, 0x000200f8, 0x00000005, 0x000100fd, 0x00010038,
+};
+
+void writeFile(const fs::path& path, std::span<const std::byte> contents) {
+	std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+}
+
+std::vector<std::byte> readFile(const fs::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	auto view = std::as_bytes(std::span { bytes });
+	return { view.begin(), view.end() };
+}
+
+// Writes a library of copied SPIR-V modules, which needs no compiler. It covers groups and several SPIR-V versions
+// of the same entry point.
+fs::path writeSpirvLibrary(const fs::path& directory) {
+	auto spirv13 = computeSpirv;
+	auto spirv16 = computeSpirv;
+	spirv16[1] = 0x00010600;
+	writeFile(directory / "compute_1_3.spv", std::as_bytes(std::span { spirv13 }));
+	writeFile(directory / "compute_1_6.spv", std::as_bytes(std::span { spirv16 }));
+
+	auto jsonPath = directory / "determinism_spirv.json";
+	std::ofstream json(jsonPath, std::ios::out | std::ios::trunc);
+	json << "{\n  \"name\": \"determinism_spirv\",\n  \"shaders\": [\n"
+	     << "    { \"name\": \"blur\", \"source\": \"compute_1_3.spv\", \"lang\": \"SPIRV\", \"target\": \"SPIRV\", \"group\": \"post\","
+	        " \"entryPoints\": [{ \"name\": \"main\", \"stage\": \"compute\" }] },\n"
+	     << "    { \"name\": \"blur\", \"source\": \"compute_1_6.spv\", \"lang\": \"SPIRV\", \"target\": \"SPIRV\", \"group\": \"post\","
+	        " \"entryPoints\": [{ \"name\": \"main\", \"stage\": \"compute\" }] },\n"
+	     << "    { \"name\": \"cull\", \"source\": \"compute_1_3.spv\", \"lang\": \"SPIRV\", \"target\": \"SPIRV\","
+	        " \"entryPoints\": [{ \"name\": \"main\", \"stage\": \"compute\" }] }\n"
+	     << "  ]\n}\n";
+	return jsonPath;
+}
+
+// Runs the processor on the manifest with the given working directory, into which it writes its outputs.
+bool runProcessor(const TestOptions& options, const fs::path& manifest, const fs::path& workingDirectory, std::uint32_t jobs) {
+	fs::create_directories(workingDirectory);
+	std::vector<std::string> args = { options.processorPath.string(), "--force", "--header", "--jobs", std::to_string(jobs), "--manifest",
+		                              manifest.string() };
+	std::vector<char*> argv;
+	for (auto& arg : args) {
+		argv.emplace_back(arg.data());
+	}
+	argv.emplace_back(nullptr);
+
+	auto logPath = workingDirectory / "processor.log";
+	auto pid = ::fork();
+	if (pid < 0) {
+		std::cerr << "Failed to start " << options.processorPath << std::endl;
+		return false;
+	}
+	if (pid == 0) {
+		auto log = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (log < 0 || ::chdir(workingDirectory.c_str()) != 0) {
+			::_exit(127);
+		}
+		::dup2(log, STDOUT_FILENO);
+		::dup2(log, STDERR_FILENO);
+		::execv(argv.front(), argv.data());
+		::_exit(127);
+	}
+
+	int status = 0;
+	if (::waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		std::cerr << "The processor failed in " << workingDirectory << ", see " << logPath << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Returns the names of all libraries and ID headers the processor wrote, which excludes its input manifests.
+std::vector<std::string> getOutputNames(const fs::path& outputFolder) {
+	std::vector<std::string> names;
+	for (const auto& entry : fs::directory_iterator(outputFolder)) {
+		auto name = entry.path().filename().string();
+		if (name.ends_with(".shader") || name.ends_with(".ids.hpp")) {
+			names.emplace_back(std::move(name));
+		}
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+// Checks that the bytes which carry no value are zero, as anything else would depend on what was in memory.
+bool checkUnusedBytes(const std::string& name, std::span<const std::byte> library) {
+	if (library.size() < sizeof(shaders::ShaderFileHeader)) {
+		std::cerr << name << ": too small for a library" << std::endl;
+		return false;
+	}
+	shaders::ShaderFileHeader header = {};
+	std::memcpy(&header, library.data(), sizeof(header));
+	if (header.reserved != 0) {
+		std::cerr << name << ": the reserved header bytes are not zero" << std::endl;
+		return false;
+	}
+	if (sizeof(header) + sizeof(shaders::ShaderDescription) * header.shaderCount > library.size()) {
+		std::cerr << name << ": too small for " << header.shaderCount << " shaders" << std::endl;
+		return false;
+	}
+
+	constexpr auto paddingOffset = offsetof(shaders::ShaderDescription, spirvVersion) + sizeof(shaders::ShaderDescription::spirvVersion);
+	for (std::size_t i = 0; i < header.shaderCount; ++i) {
+		auto description = library.subspan(sizeof(header) + sizeof(shaders::ShaderDescription) * i, sizeof(shaders::ShaderDescription));
+		auto padding = description.subspan(paddingOffset);
+		if (std::any_of(padding.begin(), padding.end(), [](std::byte value) { return value != std::byte { 0 }; })) {
+			std::cerr << name << ": the padding of description " << i << " is not zero" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	TestOptions options;
+	std::span<char*> args = { std::next(argv), static_cast<size_t>(argc - 1) };
+	for (auto it = args.begin(); it != args.end(); ++it) {
+		std::string_view arg = *it;
+		if (arg == "--glsl") {
+			options.glsl = true;
+			continue;
+		}
+
+		if (std::next(it) == args.end()) {
+			std::cerr << "Missing value after " << arg << "." << std::endl;
+			return -1;
+		}
+		std::string_view value = *(++it);
+
+		if (arg == "--processor") {
+			options.processorPath = fs::absolute(value);
+		} else if (arg == "--directory") {
+			options.directory = value;
+		} else {
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			return -1;
+		}
+	}
+
+	if (options.processorPath.empty()) {
+		std::cerr << "Usage: determinism_test --processor <shaderprocessor> [--directory <dir>] [--glsl]" << std::endl;
+		return -1;
+	}
+
+	options.directory = fs::absolute(options.directory);
+	fs::remove_all(options.directory);
+	auto inputFolder = options.directory / "inputs";
+	fs::create_directories(inputFolder);
+
+	std::vector<fs::path> jsons = { writeSpirvLibrary(inputFolder) };
+	if (options.glsl) {
+		auto corpus = sb::generateCorpus(options.directory / "corpus", sb::CorpusOptions {
+			.shaderCount = 48,
+			.shadersPerLibrary = 16,
+			.includeDepth = 4,
+		});
+		jsons.insert(jsons.end(), corpus.jsons.begin(), corpus.jsons.end());
+	}
+
+	auto manifest = options.directory / "manifest.json";
+	{
+		std::ofstream out(manifest, std::ios::out | std::ios::trunc);
+		out << "{\n  \"libraries\": [";
+		for (std::size_t i = 0; i < jsons.size(); ++i) {
+			out << (i == 0 ? "\n" : ",\n") << "    { \"json\": \"" << jsons[i].generic_string() << "\" }";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+	// The two runs differ in their parallelism and in their working directory, neither of which may show up in the outputs.
+	auto serialFolder = options.directory / "serial";
+	auto parallelFolder = options.directory / "parallel";
+	if (!runProcessor(options, manifest, serialFolder, 1) || !runProcessor(options, manifest, parallelFolder, 8)) {
+		return -1;
+	}
+
+	auto serialOutputs = getOutputNames(serialFolder / "shaders");
+	auto parallelOutputs = getOutputNames(parallelFolder / "shaders");
+	if (serialOutputs.empty() || serialOutputs != parallelOutputs) {
+		std::cerr << "The runs wrote different outputs" << std::endl;
+		return -1;
+	}
+
+	bool passed = true;
+	for (const auto& name : serialOutputs) {
+		auto serial = readFile(serialFolder / "shaders" / name);
+		auto parallel = readFile(parallelFolder / "shaders" / name);
+		if (serial != parallel) {
+			std::cerr << name << ": differs between the runs" << std::endl;
+			passed = false;
+		} else if (name.ends_with(".shader") && !checkUnusedBytes(name, serial)) {
+			passed = false;
+		}
+	}
+
+	if (!passed) {
+		return -1;
+	}
+	std::cout << "Compared " << serialOutputs.size() << " outputs" << std::endl;
+	return 0;
+}